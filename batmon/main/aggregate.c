@@ -0,0 +1,105 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "aggregate.h"
+#include "registry.h"
+
+typedef struct aggregate_state_t {
+    int64_t sum;   // wide enough for any number of int16 frames we will ever see in one period
+    uint32_t count;
+    int16_t min;
+    int16_t max;
+    int16_t last;
+    int64_t first_timestamp_us;
+    int64_t last_timestamp_us;
+} aggregate_state_t;
+
+static aggregate_state_t aggregate_state[REGISTRY_CHANNEL_COUNT];
+
+static void aggregate_reset(aggregate_state_t *state) {
+    memset(state, 0, sizeof(aggregate_state_t));
+    state->min = INT16_MAX;
+    state->max = INT16_MIN;
+}
+
+/* Divide rounding half away from zero, the divisor must be positive */
+static int64_t aggregate_divide(int64_t dividend, int64_t divisor) {
+    if (dividend < 0) {
+        return (dividend - divisor / 2) / divisor;
+    }
+    return (dividend + divisor / 2) / divisor;
+}
+
+void aggregate_init(void) {
+    registry_init();
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        aggregate_reset(&aggregate_state[channel]);
+    }
+}
+
+bool aggregate_add(uint8_t device_id, int16_t value, int64_t timestamp_us) {
+    uint8_t channel = registry_channel(device_id);
+    if (channel == REGISTRY_NO_CHANNEL) {
+        return false; // unregistered device
+    }
+    aggregate_state_t *state = &aggregate_state[channel];
+    if (state->count == 0) {
+        state->first_timestamp_us = timestamp_us;
+    }
+    state->last_timestamp_us = timestamp_us;
+    state->sum += value;
+    state->min = value < state->min ? value : state->min;
+    state->max = value > state->max ? value : state->max;
+    state->last = value;
+    state->count++;
+    return true;
+}
+
+/* Convert raw / count to milli-units of the channel */
+int32_t aggregate_scale(uint8_t channel, int64_t raw, uint32_t count) {
+    const registry_entry_t *entry = registry_entry(channel);
+    return (int32_t)aggregate_divide(raw * entry->scale_num, (int64_t)entry->scale_den * count);
+}
+
+void aggregate_flush(aggregate_result_t results[REGISTRY_CHANNEL_COUNT]) {
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        aggregate_state_t *state = &aggregate_state[channel];
+        aggregate_result_t *result = &results[channel];
+        result->count = state->count;
+        result->sum = state->sum;
+        result->min = state->min;
+        result->max = state->max;
+        result->value_milli = 0;
+        result->timestamp_us = 0;
+        result->latest_us = state->last_timestamp_us;
+        if (state->count > 0) {
+            switch (registry_entry(channel)->aggregate) {
+                case REGISTRY_AGGREGATE_MEAN:
+                    result->value_milli = aggregate_scale(channel, state->sum, state->count);
+                    break;
+                case REGISTRY_AGGREGATE_MIN:
+                    result->value_milli = aggregate_scale(channel, state->min, 1);
+                    break;
+                case REGISTRY_AGGREGATE_MAX:
+                    result->value_milli = aggregate_scale(channel, state->max, 1);
+                    break;
+                case REGISTRY_AGGREGATE_LAST:
+                    result->value_milli = aggregate_scale(channel, state->last, 1);
+                    break;
+            }
+            result->timestamp_us = state->first_timestamp_us +
+                                   (state->last_timestamp_us - state->first_timestamp_us) / 2;
+        }
+        aggregate_reset(state);
+    }
+}
+
+/* Format a milli-unit value as a decimal string with three places, without using floats */
+int aggregate_format_milli(char *buffer, size_t size, int32_t value_milli) {
+    const char *sign = value_milli < 0 ? "-" : "";
+    uint32_t magnitude = value_milli < 0 ? -(uint32_t)value_milli : (uint32_t)value_milli;
+    return snprintf(buffer, size, "%s%lu.%03lu", sign, (unsigned long)(magnitude / 1000),
+                    (unsigned long)(magnitude % 1000));
+}
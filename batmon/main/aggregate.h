@@ -0,0 +1,34 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "registry.h"
+
+typedef struct aggregate_result_t {
+    int32_t value_milli;  // scaled and reduced according to the registry entry, in milli-units
+    uint32_t count;       // number of frames reduced, zero if the channel was silent
+    int64_t timestamp_us; // centre of the frames that were reduced
+    int64_t latest_us;    // the newest of them
+    int64_t sum;          // raw counts, for consumers that combine several periods
+    int16_t min;
+    int16_t max;
+} aggregate_result_t;
+
+void aggregate_init(void);
+bool aggregate_add(uint8_t device_id, int16_t value, int64_t timestamp_us);
+void aggregate_flush(aggregate_result_t results[REGISTRY_CHANNEL_COUNT]);
+int32_t aggregate_scale(uint8_t channel, int64_t raw, uint32_t count);
+int aggregate_format_milli(char *buffer, size_t size, int32_t value_milli);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* AGGREGATE_H_ */
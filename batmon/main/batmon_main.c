@@ -9,23 +9,127 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include "aggregate.h"
+#include "batmon_littlefs.h"
 #include "batmon_wifi.h"
+#include "burst.h"
+#include "bus.h"
+#include "cycle.h"
+#include "ekf.h"
 #include "driver/gpio.h"
 #include "hardware.h"
+#include "live.h"
 #include "nvm_esp.h"
+#include "power.h"
+#include "push.h"
+#include "registry.h"
+#include "resistance.h"
 #include "rest_server.h"
+#include "rules.h"
+#include "sketch.h"
 #include "sntp_client.h"
+#include "soc.h"
+#include "spectrum.h"
 #include "storage.h"
 #include "tinbus.h"
+#include "window.h"
 
+#include <stdio.h>
 #include <sys/time.h>
 #include <time.h>
 
-#define DEVICE_CURRENT_ID 1
-#define DEVICE_VOLTAGE_ID 2
+#define BATMON_RECORD_SIZE 128
+#define BATMON_SKETCH_PERIOD_S 60
 
 static const char *TAG = "batmon";
 
+/* Write one "stream,timestamp_us,value,..." record holding every channel of the stream */
+static void batmon_write_record(storage_handle_t handle, uint8_t stream,
+                                const aggregate_result_t results[REGISTRY_CHANNEL_COUNT]) {
+    char record[BATMON_RECORD_SIZE];
+    bool empty = true;
+    int size = snprintf(record, sizeof(record), "%d", stream);
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        if (registry_entry(channel)->stream != stream) {
+            continue;
+        }
+        if (results[channel].count == 0) {
+            return; // only log complete records
+        }
+        if (empty) {
+            size += snprintf(&record[size], sizeof(record) - size, ",%lld",
+                             results[channel].timestamp_us);
+            empty = false;
+        }
+        if (size < sizeof(record)) {
+            record[size++] = ',';
+            size += aggregate_format_milli(&record[size], sizeof(record) - size,
+                                           results[channel].value_milli);
+        }
+    }
+    if ((!empty) && (size < sizeof(record))) {
+        storage_write_string(handle, record);
+        ESP_LOGI(TAG, "%s", record);
+    }
+}
+
+/* Write one percentile and variance record per channel that saw frames this period */
+static void batmon_write_sketches(storage_handle_t handle, int64_t timestamp_us) {
+    sketch_result_t results[REGISTRY_CHANNEL_COUNT];
+    sketch_flush(results);
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        if (results[channel].count > 0) {
+            char record[BATMON_RECORD_SIZE];
+            if (sketch_serialise(record, sizeof(record), channel, timestamp_us,
+                                 &results[channel]) < sizeof(record)) {
+                storage_write_string(handle, record);
+                ESP_LOGI(TAG, "%s", record);
+            }
+        }
+    }
+}
+
+/* Log each internal resistance estimate as it is made */
+static void batmon_write_resistance(storage_handle_t handle) {
+    resistance_result_t result;
+    resistance_get(&result);
+    char record[BATMON_RECORD_SIZE];
+    if (resistance_serialise(record, sizeof(record), &result) < sizeof(record)) {
+        storage_write_string(handle, record);
+        ESP_LOGI(TAG, "%s", record);
+    }
+}
+
+/*
+ * Log each completed charge or discharge phase to the main ring alongside the 1 Hz records, and
+ * to the cycle ring that keeps months of them. That ring is synced at once, since a phase ends
+ * hours apart from the next and must not sit in the write buffer until a reset loses it.
+ */
+static void batmon_write_cycle(storage_handle_t handle, storage_handle_t cycle_handle) {
+    cycle_result_t result;
+    cycle_get(&result);
+    char record[BATMON_RECORD_SIZE];
+    if (cycle_serialise(record, sizeof(record), &result) < sizeof(record)) {
+        storage_write_string(handle, record);
+        if (cycle_handle != NULL) {
+            storage_write_string(cycle_handle, record);
+            storage_write_sync(cycle_handle);
+        }
+        ESP_LOGI(TAG, "%s", record);
+    }
+}
+
+/* Drain a frozen burst capture into the storage ring, which re-arms its trigger */
+static void batmon_write_burst(storage_handle_t handle) {
+    char record[BATMON_RECORD_SIZE];
+    int size;
+    while ((size = burst_serialise(record, sizeof(record))) > 0) {
+        if (size < sizeof(record)) {
+            storage_write_string(handle, record);
+        }
+    }
+}
+
 void app_main(void) {
 
     ESP_ERROR_CHECK(nvs_flash_init());
@@ -37,7 +141,7 @@ void app_main(void) {
 
     // batmon_littlefs_init();
     // batmon_littlefs_mount_sdspi();
-    // ESP_ERROR_CHECK(start_rest_server(BATMON_LITTLEFS_BASE_PATH));
+    ESP_ERROR_CHECK(start_rest_server(BATMON_LITTLEFS_BASE_PATH)); // the web UI is built in
 
     // sntp_client_init();
 
@@ -49,13 +153,29 @@ vTaskDelay(pdMS_TO_TICKS(10));
 
     storage_handle_t handle;
     storage_open(&handle, &nvm_esp);
-    
-    float current = 0;
-    int32_t current_accumulator = 0;
-    uint8_t current_count = 0;
-    float voltage = 0;
-    int32_t voltage_accumulator = 0;
-    uint8_t voltage_count = 0;
+    rest_server_set_storage(handle);
+    storage_handle_t cycle_handle;
+    if (storage_open(&cycle_handle, &nvm_esp_cycles) != NVM_OK) {
+        cycle_handle = NULL; // no cycles partition, keep them in the main ring only
+    }
+    rest_server_set_cycle_storage(cycle_handle);
+
+    bus_init();
+    live_init();
+    push_init();
+    aggregate_init();
+    window_init();
+    sketch_init();
+    power_init();
+    soc_init(NULL);
+    resistance_init();
+    cycle_init();
+    burst_init();
+    spectrum_init();
+    rules_init();
+#if CONFIG_BATMON_SOC_EKF
+    ekf_init(NULL);
+#endif
 
     uint64_t last_time_s = 0;
 
@@ -65,28 +185,71 @@ vTaskDelay(pdMS_TO_TICKS(10));
         tinbus_msg_t msg;
         if (tinbus_read(&msg) == ESP_OK) {
             hardware_debug(HARDWARE_GREENLED);
-            if (msg.device_id == DEVICE_CURRENT_ID) {
-                current_accumulator += msg.value;
-                current_count++;
+            burst_add(msg.device_id, msg.value, msg.timestamp_us);
+            aggregate_add(msg.device_id, msg.value, msg.timestamp_us);
+            bus_publish_frame(registry_channel(msg.device_id), msg.value, msg.timestamp_us);
+            sketch_add(msg.device_id, msg.value);
+            power_add(msg.device_id, msg.value, msg.timestamp_us);
+            soc_add(msg.device_id, msg.value, msg.timestamp_us);
+            if (resistance_add(msg.device_id, msg.value, msg.timestamp_us)) {
+                batmon_write_resistance(handle);
             }
-            if (msg.device_id == DEVICE_VOLTAGE_ID) {
-                voltage_accumulator += msg.value;
-                voltage_count++;
+            if (cycle_add(msg.device_id, msg.value, msg.timestamp_us)) {
+                batmon_write_cycle(handle, cycle_handle);
             }
+#if CONFIG_BATMON_SOC_EKF
+            ekf_add(msg.device_id, msg.value, msg.timestamp_us);
+#endif
         }
 
         int64_t time_s = esp_timer_get_time() / 1000000ULL;
         if (time_s != last_time_s) {
             last_time_s = time_s;
-            if ((current_count > 0) && (voltage_count > 0)) {
-                current = ((float)current_accumulator / (float)current_count) * 0.001;
-                current_accumulator = 0;
-                current_count = 0;
-                voltage = ((float)voltage_accumulator / (float)voltage_count) * 0.001;
-                voltage_accumulator = 0;
-                voltage_count = 0;
-
-                ESP_LOGI(TAG, "%lld,%.3f,%.3f", time_s, current, voltage);
+            aggregate_result_t results[REGISTRY_CHANNEL_COUNT];
+            aggregate_flush(results);
+            bus_publish_aggregates(results, esp_timer_get_time());
+            window_update(results);
+            window_stats_t windows[REGISTRY_CHANNEL_COUNT][WINDOW_COUNT];
+            for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+                window_get(channel, windows[channel]);
+            }
+            rest_server_publish_windows(windows, esp_timer_get_time());
+            rules_evaluate(results, esp_timer_get_time());
+            rules_stats_t rules;
+            rules_get(&rules);
+            rest_server_publish_rules(&rules);
+            for (uint8_t stream = 0; stream < REGISTRY_STREAM_COUNT; stream++) {
+                batmon_write_record(handle, stream, results);
+            }
+            if (burst_ready()) {
+                spectrum_result_t spectrum;
+                if (spectrum_analyse_burst(REGISTRY_CHANNEL_CURRENT, &spectrum)) {
+                    rest_server_publish_spectrum(&spectrum);
+                }
+                batmon_write_burst(handle);
+            }
+            soc_result_t soc;
+            soc_get(&soc);
+            power_result_t power;
+            power_get(&power);
+            live_publish(esp_timer_get_time(), results, &soc, &power);
+#if CONFIG_BATMON_SOC_EKF
+            ekf_result_t ekf;
+            ekf_get(&ekf);
+            rest_server_publish_soc(&soc, &ekf);
+#else
+            rest_server_publish_soc(&soc, NULL);
+#endif
+            if ((time_s % BATMON_SKETCH_PERIOD_S) == 0) {
+                batmon_write_sketches(handle, esp_timer_get_time());
+                char record[BATMON_RECORD_SIZE];
+                if (soc_serialise(record, sizeof(record), &soc) < sizeof(record)) {
+                    storage_write_string(handle, record);
+                }
+                power_flush(&power);
+                if (power_serialise(record, sizeof(record), &power) < sizeof(record)) {
+                    storage_write_string(handle, record);
+                }
             }
 
             // if (sntp_time_is_set()) {
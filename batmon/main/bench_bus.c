@@ -0,0 +1,93 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bus.h"
+
+/*
+ * Fan-out cost of bus_publish() as subscribers go from 1 to 16, then a check that a subscriber
+ * that never reads only loses its own messages and that the rate limit thins frames as asked.
+ */
+
+#define BENCH_RING_SIZE 1024
+#define BENCH_BLOCK 512 // published between drains, so rings never fill while timing
+#define BENCH_MESSAGES (1 << 21)
+#define BENCH_FRAME_US 10000
+
+BUS_STORAGE_DEFINE(bench_storage[BUS_SUBSCRIBER_COUNT], BENCH_RING_SIZE);
+
+static double bench_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_fan_out(uint32_t subscribers) {
+    bus_subscriber_t *subscriber[BUS_SUBSCRIBER_COUNT];
+    bus_init();
+    for (uint32_t i = 0; i < subscribers; i++) {
+        subscriber[i] = bus_subscribe("bench", BUS_TOPIC_MASK(BUS_TOPIC_FRAME), 0, bench_storage[i],
+                                      BENCH_RING_SIZE);
+    }
+    double elapsed = 0;
+    int64_t timestamp_us = 0;
+    uint64_t check = 0;
+    for (uint32_t block = 0; block < BENCH_MESSAGES / BENCH_BLOCK; block++) {
+        double start = bench_seconds();
+        for (uint32_t i = 0; i < BENCH_BLOCK; i++) {
+            bus_publish_frame(i & 1, (int16_t)i, timestamp_us);
+            timestamp_us += BENCH_FRAME_US;
+        }
+        elapsed += bench_seconds() - start;
+        for (uint32_t i = 0; i < subscribers; i++) {
+            bus_message_t message;
+            while (bus_receive(subscriber[i], &message)) {
+                check += message.value;
+            }
+        }
+    }
+    double ns = elapsed / BENCH_MESSAGES * 1e9;
+    printf("%2lu subscribers: %6.1f ns/message, %5.1f ns/delivery (check %llu)\n",
+           (unsigned long)subscribers, ns, ns / subscribers, (unsigned long long)check);
+}
+
+static int bench_isolation(void) {
+    bus_init();
+    bus_subscriber_t *fast = bus_subscribe("fast", BUS_TOPIC_MASK(BUS_TOPIC_FRAME), 0,
+                                           bench_storage[0], BENCH_RING_SIZE);
+    bus_subscriber_t *slow = bus_subscribe("slow", BUS_TOPIC_MASK(BUS_TOPIC_FRAME), 0,
+                                           bench_storage[1], BENCH_RING_SIZE);
+    bus_subscriber_t *limited = bus_subscribe("limited", BUS_TOPIC_MASK(BUS_TOPIC_FRAME), 1000000,
+                                              bench_storage[2], BENCH_RING_SIZE);
+    bus_subscriber_t *other = bus_subscribe("other", BUS_TOPIC_MASK(BUS_TOPIC_AGGREGATE), 0,
+                                            bench_storage[3], BENCH_RING_SIZE);
+    uint32_t received = 0;
+    uint32_t frames = 100000;
+    bus_message_t message;
+    for (uint32_t i = 0; i < frames; i++) {
+        bus_publish_frame(i & 1, (int16_t)i, (int64_t)i * BENCH_FRAME_US);
+        while (bus_receive(fast, &message)) {
+            received++;
+        }
+        while (bus_receive(limited, &message)) {
+        }
+    }
+    printf("fast %lu of %lu, slow delivered %lu dropped %lu, limited delivered %lu limited %lu, "
+           "other %lu\n",
+           (unsigned long)received, (unsigned long)frames, (unsigned long)slow->delivered,
+           (unsigned long)slow->dropped, (unsigned long)limited->delivered,
+           (unsigned long)limited->limited, (unsigned long)other->delivered);
+    // 1000 s of frames alternating between two channels, one per second on each
+    uint32_t expected_limited = 2 * (uint32_t)((int64_t)frames * BENCH_FRAME_US / 1000000);
+    return (received != frames) || (slow->delivered != BENCH_RING_SIZE) ||
+           (slow->dropped != frames - BENCH_RING_SIZE) || (limited->delivered != expected_limited) ||
+           (other->delivered != 0);
+}
+
+int main(int argc, char **argv) {
+    for (uint32_t subscribers = 1; subscribers <= BUS_SUBSCRIBER_COUNT; subscribers *= 2) {
+        bench_fan_out(subscribers);
+    }
+    return bench_isolation() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "aggregate.h"
+#include "emit.h"
+#include "history.h"
+#include "live.h"
+
+/*
+ * Response size and encode time of CBOR against JSON for the two data payloads that matter:
+ * the live snapshot a dashboard polls every second, and a day of 1 Hz history raw, averaged to
+ * one minute and reduced to an 800 pixel chart. Output is counted and discarded by the chunk
+ * sender, so the times are the CPU cost of encoding alone.
+ */
+
+#define BENCH_LIVE_ROUNDS 200000
+#define BENCH_RECORDS (24 * 3600)
+#define BENCH_CHART_POINTS 800
+#define BENCH_RECORD_SIZE 48
+#define BENCH_CHUNK_SIZE 512
+
+static char bench_records[BENCH_RECORDS][BENCH_RECORD_SIZE];
+
+static double bench_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool bench_send(void *context, const char *data, size_t size) {
+    *(uint64_t *)context += size;
+    return true;
+}
+
+static void bench_live(emit_format_t format, const live_snapshot_t *snapshot) {
+    char buffer[BENCH_CHUNK_SIZE];
+    uint64_t bytes = 0;
+    chunk_t chunk;
+    emit_t emit;
+    double start = bench_seconds();
+    for (uint32_t i = 0; i < BENCH_LIVE_ROUNDS; i++) {
+        chunk_init(&chunk, buffer, sizeof(buffer), bench_send, &bytes);
+        emit_init(&emit, format, &chunk);
+        live_encode(&emit, snapshot);
+        emit_finish(&emit);
+    }
+    double elapsed = bench_seconds() - start;
+    printf("live    %-4s: %5llu bytes, %7.1f ns per response\n",
+           format == EMIT_CBOR ? "cbor" : "json", (unsigned long long)(bytes / BENCH_LIVE_ROUNDS),
+           elapsed / BENCH_LIVE_ROUNDS * 1e9);
+}
+
+static void bench_history(history_format_t format, int64_t step_us, uint32_t max_points) {
+    char buffer[BENCH_CHUNK_SIZE];
+    uint64_t bytes = 0;
+    chunk_t chunk;
+    history_t history;
+    history_query_t query = {
+        .from_us = 0,
+        .to_us = (int64_t)BENCH_RECORDS * 1000000,
+        .step_us = step_us,
+        .series = (1UL << REGISTRY_CHANNEL_COUNT) - 1,
+        .max_points = max_points,
+        .format = format,
+    };
+    double start = bench_seconds();
+    chunk_init(&chunk, buffer, sizeof(buffer), bench_send, &bytes);
+    history_begin(&history, &query, &chunk);
+    for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+        history_add(&history, bench_records[i]);
+    }
+    history_end(&history);
+    double elapsed = bench_seconds() - start;
+    printf("history %-4s step %2llds max %3lu: %6lu points, %8llu bytes, %6.1f ms\n",
+           format == HISTORY_CBOR ? "cbor" : "json", (long long)(step_us / 1000000),
+           (unsigned long)max_points, (unsigned long)history.points, (unsigned long long)bytes,
+           elapsed * 1e3);
+}
+
+int main(int argc, char **argv) {
+    registry_init();
+    live_snapshot_t snapshot = {
+        .sequence = 86400,
+        .timestamp_us = 86400LL * 1000000,
+        .power_uw = -153250000,
+        .soc = {.synchronised = true, .soc_permille = 873, .remaining_mah = 174600},
+    };
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        snapshot.channels[channel] = (live_channel_t){
+            .value_milli = channel ? 13210 : -11602,
+            .min_milli = channel ? 13187 : -12950,
+            .max_milli = channel ? 13244 : -10044,
+            .count = 10,
+            .latest_us = snapshot.timestamp_us - 12345,
+        };
+    }
+    bench_live(EMIT_JSON, &snapshot);
+    bench_live(EMIT_CBOR, &snapshot);
+
+    for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+        double day = sin(2 * M_PI * i / BENCH_RECORDS);
+        int32_t current_milli = (int32_t)(20000 * day) + rand() % 1000 - 500;
+        int32_t voltage_milli = 13000 + (int32_t)(1000 * day) + rand() % 100;
+        int size = snprintf(bench_records[i], BENCH_RECORD_SIZE, "%d,%lld,", REGISTRY_STREAM_BATTERY,
+                            (long long)i * 1000000 + 500000);
+        size += aggregate_format_milli(&bench_records[i][size], BENCH_RECORD_SIZE - size,
+                                       current_milli);
+        bench_records[i][size++] = ',';
+        aggregate_format_milli(&bench_records[i][size], BENCH_RECORD_SIZE - size, voltage_milli);
+    }
+    const history_format_t formats[] = {HISTORY_JSON, HISTORY_CBOR};
+    for (int i = 0; i < 2; i++) {
+        bench_history(formats[i], 0, 0);
+        bench_history(formats[i], 60 * 1000000LL, 0);
+        bench_history(formats[i], 0, BENCH_CHART_POINTS);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "aggregate.h"
+#include "history.h"
+
+/*
+ * Throughput of the history query path, from stream record text to encoded output, for a week
+ * of 1 Hz records in each output format: raw, averaged to one minute, and reduced by LTTB to
+ * an 800 pixel chart. The output is counted and discarded by the chunk sender, so this is the
+ * CPU cost without the network. A single spike is planted in the current and the LTTB output
+ * is checked to still contain it.
+ */
+
+#define BENCH_RECORDS (7 * 24 * 3600)
+#define BENCH_CHART_POINTS 800
+#define BENCH_SPIKE_INDEX 123457
+#define BENCH_SPIKE_MILLI 29999
+#define BENCH_RECORD_SIZE 48
+#define BENCH_CHUNK_SIZE 512
+
+static char bench_records[BENCH_RECORDS][BENCH_RECORD_SIZE];
+
+static double bench_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint8_t bench_output[16 * BENCH_CHART_POINTS];
+static size_t bench_output_size = 0;
+
+static bool bench_send(void *context, const char *data, size_t size) {
+    *(uint64_t *)context += size;
+    return true;
+}
+
+static bool bench_capture(void *context, const char *data, size_t size) {
+    if (bench_output_size + size > sizeof(bench_output)) {
+        return false;
+    }
+    memcpy(&bench_output[bench_output_size], data, size);
+    bench_output_size += size;
+    return true;
+}
+
+/* Reduce the current alone to a chart in binary and look for the spike among the points */
+static int bench_spike(void) {
+    char buffer[BENCH_CHUNK_SIZE];
+    chunk_t chunk;
+    history_t history;
+    history_query_t query = {
+        .from_us = 0,
+        .to_us = (int64_t)BENCH_RECORDS * 1000000,
+        .step_us = 0,
+        .series = 1UL << REGISTRY_CHANNEL_CURRENT,
+        .max_points = BENCH_CHART_POINTS,
+        .format = HISTORY_BINARY,
+    };
+    chunk_init(&chunk, buffer, sizeof(buffer), bench_capture, NULL);
+    history_begin(&history, &query, &chunk);
+    for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+        history_add(&history, bench_records[i]);
+    }
+    bool sent = history_end(&history);
+    bool found = false;
+    for (size_t offset = 8; offset + 4 <= bench_output_size; offset += 12) {
+        int32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= (int32_t)((uint32_t)bench_output[offset + i] << (8 * i));
+        }
+        found |= (value == BENCH_SPIKE_MILLI);
+    }
+    printf("lttb spike %s in %lu points\n", found ? "kept" : "lost", (unsigned long)history.points);
+    return !sent || !found || (history.points > BENCH_CHART_POINTS);
+}
+
+static void bench_query(history_format_t format, int64_t step_us, uint32_t max_points) {
+    static const char *names[] = {"json", "csv", "binary", "cbor"};
+    char buffer[BENCH_CHUNK_SIZE];
+    uint64_t bytes = 0;
+    chunk_t chunk;
+    history_t history;
+    history_query_t query = {
+        .from_us = 0,
+        .to_us = (int64_t)BENCH_RECORDS * 1000000,
+        .step_us = step_us,
+        .series = (1UL << REGISTRY_CHANNEL_COUNT) - 1,
+        .max_points = max_points,
+        .format = format,
+    };
+    double start = bench_seconds();
+    chunk_init(&chunk, buffer, sizeof(buffer), bench_send, &bytes);
+    history_begin(&history, &query, &chunk);
+    for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+        history_add(&history, bench_records[i]);
+    }
+    history_end(&history);
+    double elapsed = bench_seconds() - start;
+    printf("%-6s step %2llds max %3lu: %6lu points, %8llu bytes, %6.1f ms, %6.2f M records/s, "
+           "%6.3f M points/s\n",
+           names[format], (long long)(step_us / 1000000), (unsigned long)max_points,
+           (unsigned long)history.points,
+           (unsigned long long)bytes, elapsed * 1e3, BENCH_RECORDS / elapsed * 1e-6,
+           history.points / elapsed * 1e-6);
+}
+
+int main(int argc, char **argv) {
+    registry_init();
+    for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+        // a slow daily swing with some noise, so the chart has a shape to keep
+        double day = sin(2 * M_PI * i / (24 * 3600));
+        int32_t current_milli = (int32_t)(20000 * day) + rand() % 1000 - 500;
+        int32_t voltage_milli = 13000 + (int32_t)(1000 * day) + rand() % 100;
+        if (i == BENCH_SPIKE_INDEX) {
+            current_milli = BENCH_SPIKE_MILLI;
+        }
+        int size = snprintf(bench_records[i], BENCH_RECORD_SIZE, "%d,%lld,", REGISTRY_STREAM_BATTERY,
+                            (long long)i * 1000000 + 500000);
+        size += aggregate_format_milli(&bench_records[i][size], BENCH_RECORD_SIZE - size,
+                                       current_milli);
+        bench_records[i][size++] = ',';
+        aggregate_format_milli(&bench_records[i][size], BENCH_RECORD_SIZE - size, voltage_milli);
+    }
+    for (history_format_t format = HISTORY_JSON; format <= HISTORY_CBOR; format++) {
+        bench_query(format, 0, 0);
+        bench_query(format, 60 * 1000000LL, 0);
+        bench_query(format, 0, BENCH_CHART_POINTS);
+    }
+    return bench_spike() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "live.h"
+
+/*
+ * Readers poll live_read() while a writer publishes as fast as it can, far harder than the
+ * 1 Hz acquisition task. Every field of a published snapshot carries the same number, so a torn
+ * read shows up as a mismatch. Read latency is reported as the reader count goes from 1 to 16,
+ * along with how many writes were completed meanwhile, which readers must not hold back.
+ */
+
+#define BENCH_READS 200000
+#define BENCH_READERS_MAX 16
+
+static atomic_int bench_running;
+static atomic_uint_least64_t bench_writes;
+
+static double bench_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *bench_writer(void *arg) {
+    int32_t n = 0;
+    while (atomic_load(&bench_running)) {
+        n++;
+        aggregate_result_t results[REGISTRY_CHANNEL_COUNT];
+        for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+            results[channel] = (aggregate_result_t){.value_milli = n, .count = 1, .latest_us = n};
+        }
+        soc_result_t soc = {.timestamp_us = n, .remaining_mah = n};
+        power_result_t power = {.power_uw = n};
+        live_publish(n, results, &soc, &power);
+        atomic_fetch_add(&bench_writes, 1);
+    }
+    return NULL;
+}
+
+typedef struct bench_reader_t {
+    pthread_t thread;
+    double seconds;
+    uint32_t torn;
+    uint32_t busy; // live_read() gave up and the reader yielded
+} bench_reader_t;
+
+static void *bench_reader(void *arg) {
+    bench_reader_t *reader = arg;
+    live_snapshot_t live;
+    double start = bench_seconds();
+    for (uint32_t i = 0; i < BENCH_READS; i++) {
+        while (!live_read(&live)) {
+            reader->busy++;
+            sched_yield();
+        }
+        int64_t n = live.timestamp_us;
+        for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+            reader->torn += (live.channels[channel].value_milli != n) ||
+                            (live.channels[channel].latest_us != n);
+        }
+        reader->torn += (live.soc.timestamp_us != n) || (live.soc.remaining_mah != n) ||
+                        (live.power_uw != n) || (live.sequence != (uint32_t)n);
+    }
+    reader->seconds = bench_seconds() - start;
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    uint32_t torn = 0;
+    for (uint32_t readers = 1; readers <= BENCH_READERS_MAX; readers *= 2) {
+        bench_reader_t reader[BENCH_READERS_MAX] = {0};
+        pthread_t writer;
+        live_init();
+        atomic_store(&bench_running, 1);
+        atomic_store(&bench_writes, 0);
+        pthread_create(&writer, NULL, bench_writer, NULL);
+        double start = bench_seconds();
+        for (uint32_t i = 0; i < readers; i++) {
+            pthread_create(&reader[i].thread, NULL, bench_reader, &reader[i]);
+        }
+        double seconds = 0;
+        uint32_t busy = 0;
+        for (uint32_t i = 0; i < readers; i++) {
+            pthread_join(reader[i].thread, NULL);
+            seconds += reader[i].seconds;
+            torn += reader[i].torn;
+            busy += reader[i].busy;
+        }
+        double elapsed = bench_seconds() - start;
+        atomic_store(&bench_running, 0);
+        pthread_join(writer, NULL);
+        // mean wall time per read, which includes any time a reader spent preempted
+        printf("%2lu readers: %6.0f ns/read, %8.0f writes/s, %lu retries, %lu torn\n",
+               (unsigned long)readers, seconds / readers / BENCH_READS * 1e9,
+               atomic_load(&bench_writes) / elapsed, (unsigned long)busy, (unsigned long)torn);
+    }
+    return torn ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "spectrum.h"
+
+#define BENCH_REPEATS 200
+#define BENCH_AMPLITUDE 1000.0f
+
+static int16_t data[SPECTRUM_MAX_POINTS];
+
+static double bench_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* A tone on bin points / 8 plus a smaller one on bin points / 3 */
+static void bench_signal(uint32_t points) {
+    for (uint32_t i = 0; i < points; i++) {
+        float t = (float)i / points;
+        data[i] = lrintf(BENCH_AMPLITUDE * cosf(2.0f * (float)M_PI * (points / 8) * t) +
+                         0.25f * BENCH_AMPLITUDE * sinf(2.0f * (float)M_PI * (points / 3) * t));
+    }
+}
+
+int main(int argc, char **argv) {
+    int failures = 0;
+    spectrum_init();
+    for (uint32_t points = 256; points <= SPECTRUM_MAX_POINTS; points <<= 1) {
+        double elapsed = 0;
+        int exponent = 0;
+        for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+            bench_signal(points);
+            double start = bench_seconds();
+            exponent = spectrum_fft(data, points);
+            elapsed += bench_seconds() - start;
+        }
+
+        uint32_t peak = 0;
+        float peak_magnitude = 0;
+        for (uint32_t k = 1; k < points / 2; k++) {
+            float magnitude = hypotf(data[2 * k], data[2 * k + 1]) * ldexpf(1.0f, exponent);
+            if (magnitude > peak_magnitude) {
+                peak_magnitude = magnitude;
+                peak = k;
+            }
+        }
+        // a tone of amplitude a has a bin magnitude of a * points / 2
+        float amplitude = 2.0f * peak_magnitude / points;
+        bool ok = (peak == points / 8) && (fabsf(amplitude - BENCH_AMPLITUDE) < 0.02f * BENCH_AMPLITUDE);
+        failures += !ok;
+        printf("%4lu points: %8.2f us per transform, peak bin %lu amplitude %.1f %s\n",
+               (unsigned long)points, elapsed / BENCH_REPEATS * 1e6, (unsigned long)peak,
+               amplitude, ok ? "ok" : "FAIL");
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
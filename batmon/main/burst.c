@@ -0,0 +1,256 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "burst.h"
+#include "registry.h"
+
+/*
+ * Pre / post trigger capture of raw frames. Every frame is written to a power of two ring that
+ * always holds the last BURST_RING_SIZE frames. A trigger marks the frame that fired it; once
+ * BURST_POST_US has passed the window from BURST_PRE_US before the trigger is frozen until
+ * burst_serialise() has drained it. The ring keeps recording while frozen, only dropping frames
+ * if it would wrap onto the frozen window.
+ *
+ * The limits fire when a channel first goes past them, not for as long as it stays there, and
+ * the channel has to come back inside by the hysteresis band before it can fire again. After a
+ * burst is drained automatic triggers are held off for BURST_HOLDOFF_US, so a condition that
+ * keeps flapping cannot keep the logger writing bursts. Limits are converted to raw counts at
+ * init and the slew limit to counts per millisecond, so the per frame cost is the ring write
+ * and a few 32 bit compares.
+ */
+
+#define BURST_PRE_US (5 * 1000000LL)
+#define BURST_POST_US (5 * 1000000LL)
+#define BURST_FRAME_RATE_HZ 20 // every registered channel at 10 Hz
+#define BURST_HOLDOFF_US (60 * 1000000LL)
+#define BURST_SLEW_GAP_MS 1000 // frames further apart than this are not checked for slew
+#define BURST_FRAMES_PER_RECORD 4
+
+// the window, twice over so the ring can keep recording while a burst waits to be drained
+#define BURST_WINDOW_FRAMES (((BURST_PRE_US + BURST_POST_US) * BURST_FRAME_RATE_HZ) / 1000000)
+#define BURST_SMEAR(x) ((x) | (x) >> 1 | (x) >> 2 | (x) >> 4 | (x) >> 8)
+#define BURST_RING_SIZE (BURST_SMEAR(BURST_SMEAR(2 * BURST_WINDOW_FRAMES - 1)) + 1)
+#define BURST_RING_MASK (BURST_RING_SIZE - 1)
+
+_Static_assert(2 * BURST_WINDOW_FRAMES <= 0x10000, "burst window too long for the ring size");
+
+typedef struct burst_limit_t {
+    int32_t low_milli; // fire below this, INT32_MIN to disable
+    int32_t high_milli; // fire above this, INT32_MAX to disable
+    int32_t slew_milli_per_s; // fire on a faster change between frames, 0 to disable
+    int32_t hysteresis_milli; // how far back inside a limit before it can fire again
+} burst_limit_t;
+
+static const burst_limit_t burst_limits[REGISTRY_CHANNEL_COUNT] = {
+    [REGISTRY_CHANNEL_CURRENT] = {.low_milli = -30000,
+                                  .high_milli = 30000,
+                                  .slew_milli_per_s = 0,
+                                  .hysteresis_milli = 1000},
+    [REGISTRY_CHANNEL_VOLTAGE] = {.low_milli = 11500,
+                                  .high_milli = 15000,
+                                  .slew_milli_per_s = 2000,
+                                  .hysteresis_milli = 200},
+};
+
+typedef struct burst_raw_limit_t {
+    int32_t low;
+    int32_t high;
+    int32_t low_clear; // back inside once above this
+    int32_t high_clear; // and below this
+    uint32_t slew_q8; // raw counts per millisecond, 8 fractional bits, 0 if disabled
+    int16_t last_value;
+    uint32_t last_us; // low bits of the last timestamp, enough for the gap between frames
+    bool have_last;
+    bool outside; // past the low or high limit and not yet back inside the band
+    bool slewing; // the last change was too fast
+} burst_raw_limit_t;
+
+typedef enum {
+    BURST_ARMED = 0,
+    BURST_CAPTURING,
+    BURST_FROZEN,
+} burst_state_t;
+
+typedef struct burst_ctx_t {
+    burst_frame_t ring[BURST_RING_SIZE];
+    uint32_t head; // frames written since init
+    burst_state_t state;
+    burst_trigger_t reason;
+    uint32_t trigger_index;
+    int64_t trigger_us;
+    int64_t holdoff_us; // no automatic trigger before this
+    uint32_t start_index; // frozen window, and the read cursor while it drains
+    uint32_t end_index;
+    bool header_sent;
+    uint32_t dropped;
+    volatile bool manual;
+    burst_raw_limit_t limits[REGISTRY_CHANNEL_COUNT];
+} burst_ctx_t;
+
+static burst_ctx_t burst_ctx;
+
+/* Convert a milli-unit limit to raw counts of the channel */
+static int64_t burst_raw(uint8_t channel, int64_t milli) {
+    const registry_entry_t *entry = registry_entry(channel);
+    return (milli * entry->scale_den) / entry->scale_num;
+}
+
+/* Track a channel against its limits, returning a trigger only as a limit is first crossed */
+static burst_trigger_t burst_check(burst_raw_limit_t *limit, int16_t value, int64_t timestamp_us) {
+    burst_trigger_t reason = BURST_TRIGGER_NONE;
+    if ((value < limit->low) || (value > limit->high)) {
+        if (!limit->outside) {
+            limit->outside = true;
+            reason = value < limit->low ? BURST_TRIGGER_LOW : BURST_TRIGGER_HIGH;
+        }
+    } else if ((value > limit->low_clear) && (value < limit->high_clear)) {
+        limit->outside = false;
+    }
+    uint32_t now_us = (uint32_t)timestamp_us;
+    if (limit->slew_q8 && limit->have_last) {
+        uint32_t gap_ms = (now_us - limit->last_us + 500) / 1000;
+        bool slewing = false;
+        if (gap_ms <= BURST_SLEW_GAP_MS) {
+            int32_t change = (int32_t)value - limit->last_value;
+            uint32_t magnitude = (uint32_t)(change < 0 ? -change : change);
+            slewing = (magnitude << 8) > limit->slew_q8 * (gap_ms ? gap_ms : 1);
+        }
+        if (slewing && !limit->slewing && (reason == BURST_TRIGGER_NONE)) {
+            reason = BURST_TRIGGER_SLEW;
+        }
+        limit->slewing = slewing;
+    }
+    limit->last_value = value;
+    limit->last_us = now_us;
+    limit->have_last = true;
+    return reason;
+}
+
+static void burst_freeze(burst_ctx_t *ctx) {
+    uint32_t start = ctx->trigger_index;
+    while ((ctx->head - start < BURST_RING_SIZE) && (start != 0) &&
+           (ctx->trigger_us - ctx->ring[(start - 1) & BURST_RING_MASK].timestamp_us <=
+            BURST_PRE_US)) {
+        start--;
+    }
+    ctx->start_index = start;
+    ctx->end_index = ctx->head;
+    ctx->header_sent = false;
+    ctx->state = BURST_FROZEN;
+}
+
+void burst_init(void) {
+    memset(&burst_ctx, 0, sizeof(burst_ctx));
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        const burst_limit_t *limit = &burst_limits[channel];
+        burst_raw_limit_t *raw = &burst_ctx.limits[channel];
+        int32_t hysteresis = burst_raw(channel, limit->hysteresis_milli);
+        raw->low = limit->low_milli == INT32_MIN ? INT32_MIN : burst_raw(channel, limit->low_milli);
+        raw->high =
+            limit->high_milli == INT32_MAX ? INT32_MAX : burst_raw(channel, limit->high_milli);
+        raw->low_clear = raw->low == INT32_MIN ? INT32_MIN : raw->low + hysteresis;
+        raw->high_clear = raw->high == INT32_MAX ? INT32_MAX : raw->high - hysteresis;
+        raw->slew_q8 = (uint32_t)((burst_raw(channel, limit->slew_milli_per_s) * 256) / 1000);
+    }
+}
+
+void burst_add(uint8_t device_id, int16_t value, int64_t timestamp_us) {
+    burst_ctx_t *ctx = &burst_ctx;
+    if ((ctx->state == BURST_FROZEN) && (ctx->head - ctx->start_index >= BURST_RING_SIZE)) {
+        ctx->dropped++; // the frozen window has not been drained yet
+        return;
+    }
+    burst_frame_t *frame = &ctx->ring[ctx->head & BURST_RING_MASK];
+    frame->timestamp_us = timestamp_us;
+    frame->device_id = device_id;
+    frame->value = value;
+    ctx->head++;
+
+    uint8_t channel = registry_channel(device_id);
+    burst_trigger_t reason = BURST_TRIGGER_NONE;
+    if (channel != REGISTRY_NO_CHANNEL) {
+        reason = burst_check(&ctx->limits[channel], value, timestamp_us);
+    }
+    if (timestamp_us < ctx->holdoff_us) {
+        reason = BURST_TRIGGER_NONE;
+    }
+    if ((ctx->state == BURST_ARMED) && ctx->manual) {
+        ctx->manual = false;
+        reason = BURST_TRIGGER_MANUAL;
+    }
+    if ((ctx->state == BURST_ARMED) && (reason != BURST_TRIGGER_NONE)) {
+        ctx->state = BURST_CAPTURING;
+        ctx->reason = reason;
+        ctx->trigger_index = ctx->head - 1;
+        ctx->trigger_us = timestamp_us;
+    }
+    if ((ctx->state == BURST_CAPTURING) &&
+        ((timestamp_us - ctx->trigger_us >= BURST_POST_US) ||
+         (ctx->head - ctx->trigger_index >= BURST_RING_SIZE / 2))) {
+        burst_freeze(ctx);
+    }
+}
+
+/* Request a capture from another task, it fires on the next frame; false while one is in progress */
+bool burst_trigger(void) {
+    if (burst_ctx.state != BURST_ARMED) {
+        return false;
+    }
+    burst_ctx.manual = true;
+    return true;
+}
+
+bool burst_ready(void) { return burst_ctx.state == BURST_FROZEN; }
+
+/* Frames of a frozen burst that has not started draining, zero otherwise */
+uint32_t burst_frame_count(void) {
+    const burst_ctx_t *ctx = &burst_ctx;
+    if ((ctx->state != BURST_FROZEN) || ctx->header_sent) {
+        return 0;
+    }
+    return ctx->end_index - ctx->start_index;
+}
+
+const burst_frame_t *burst_frame(uint32_t index) {
+    return &burst_ctx.ring[(burst_ctx.start_index + index) & BURST_RING_MASK];
+}
+
+/*
+ * Serialise the next record of a frozen burst: a "B,trigger_us,reason,frames,dropped" header
+ * and then "b,offset_us,device_id,value,..." records holding BURST_FRAMES_PER_RECORD frames with
+ * times relative to the trigger. Returns 0 once the burst is drained and the trigger re-armed.
+ */
+int burst_serialise(char *buffer, size_t size) {
+    burst_ctx_t *ctx = &burst_ctx;
+    if (ctx->state != BURST_FROZEN) {
+        return 0;
+    }
+    if (!ctx->header_sent) {
+        ctx->header_sent = true;
+        int length = snprintf(buffer, size, BURST_RECORD_TAG ",%lld,%d,%lu,%lu",
+                              (long long)ctx->trigger_us, ctx->reason,
+                              (unsigned long)(ctx->end_index - ctx->start_index),
+                              (unsigned long)ctx->dropped);
+        ctx->dropped = 0;
+        return length;
+    }
+    if (ctx->start_index == ctx->end_index) {
+        ctx->holdoff_us = ctx->ring[(ctx->end_index - 1) & BURST_RING_MASK].timestamp_us +
+                          BURST_HOLDOFF_US;
+        ctx->state = BURST_ARMED;
+        return 0;
+    }
+    int length = snprintf(buffer, size, BURST_FRAME_RECORD_TAG);
+    for (int i = 0; (i < BURST_FRAMES_PER_RECORD) && (ctx->start_index != ctx->end_index); i++) {
+        const burst_frame_t *frame = &ctx->ring[ctx->start_index & BURST_RING_MASK];
+        if ((length >= 0) && ((size_t)length < size)) {
+            length += snprintf(&buffer[length], size - length, ",%lld,%d,%d",
+                               (long long)(frame->timestamp_us - ctx->trigger_us),
+                               frame->device_id, frame->value);
+        }
+        ctx->start_index++;
+    }
+    return length;
+}
@@ -0,0 +1,41 @@
+#ifndef BURST_H
+#define BURST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BURST_RECORD_TAG "B"
+#define BURST_FRAME_RECORD_TAG "b"
+
+typedef enum {
+    BURST_TRIGGER_NONE = 0,
+    BURST_TRIGGER_LOW,
+    BURST_TRIGGER_HIGH,
+    BURST_TRIGGER_SLEW,
+    BURST_TRIGGER_MANUAL,
+} burst_trigger_t;
+
+typedef struct burst_frame_t {
+    int64_t timestamp_us;
+    uint8_t device_id;
+    int16_t value;
+} burst_frame_t;
+
+void burst_init(void);
+void burst_add(uint8_t device_id, int16_t value, int64_t timestamp_us);
+bool burst_trigger(void);
+bool burst_ready(void);
+uint32_t burst_frame_count(void);
+const burst_frame_t *burst_frame(uint32_t index);
+int burst_serialise(char *buffer, size_t size);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* BURST_H_ */
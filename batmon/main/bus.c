@@ -0,0 +1,107 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bus.h"
+
+/*
+ * In-process publish / subscribe of telemetry. The acquisition task publishes each message once
+ * and it is copied into the ring of every subscriber that wants its topic, subject to that
+ * subscriber's rate limit. Each ring has exactly one producer, the publisher, and one consumer,
+ * the subscriber, so there are no locks. When a ring is full the message is dropped for that
+ * subscriber only and counted, so a slow consumer never holds up the publisher or anyone else.
+ *
+ * Subscribers are normally registered at startup. A new one is filled in before the count that
+ * makes it visible to the publisher is released, so registering late is also safe, but there is
+ * no unsubscribe.
+ */
+
+typedef struct bus_ctx_t {
+    bus_subscriber_t subscribers[BUS_SUBSCRIBER_COUNT];
+    atomic_uint_least32_t count;
+} bus_ctx_t;
+
+static bus_ctx_t bus_ctx;
+
+void bus_init(void) {
+    memset(bus_ctx.subscribers, 0, sizeof(bus_ctx.subscribers));
+    atomic_store_explicit(&bus_ctx.count, 0, memory_order_release);
+}
+
+bus_subscriber_t *bus_subscribe(const char *name, uint32_t topics, int64_t interval_us,
+                                bus_message_t *storage, uint32_t count) {
+    uint32_t index = atomic_load_explicit(&bus_ctx.count, memory_order_relaxed);
+    if (index >= BUS_SUBSCRIBER_COUNT) {
+        return NULL;
+    }
+    bus_subscriber_t *subscriber = &bus_ctx.subscribers[index];
+    memset(subscriber, 0, sizeof(bus_subscriber_t));
+    if (!spsc_init(&subscriber->ring, storage, sizeof(bus_message_t), count)) {
+        return NULL;
+    }
+    subscriber->name = name;
+    subscriber->topics = topics;
+    subscriber->interval_us = interval_us;
+    atomic_store_explicit(&bus_ctx.count, index + 1, memory_order_release);
+    return subscriber;
+}
+
+void bus_publish(const bus_message_t *message) {
+    uint32_t count = atomic_load_explicit(&bus_ctx.count, memory_order_acquire);
+    uint32_t topic_mask = BUS_TOPIC_MASK(message->topic);
+    for (uint32_t i = 0; i < count; i++) {
+        bus_subscriber_t *subscriber = &bus_ctx.subscribers[i];
+        if ((subscriber->topics & topic_mask) == 0) {
+            continue;
+        }
+        if (subscriber->interval_us) {
+            int64_t *next_us = &subscriber->next_us[message->topic][message->channel];
+            if (message->timestamp_us < *next_us) {
+                subscriber->limited++;
+                continue;
+            }
+            *next_us = message->timestamp_us + subscriber->interval_us;
+        }
+        if (spsc_push(&subscriber->ring, message)) {
+            subscriber->delivered++;
+        } else {
+            subscriber->dropped++;
+        }
+    }
+}
+
+void bus_publish_frame(uint8_t channel, int16_t value, int64_t timestamp_us) {
+    if (channel >= REGISTRY_CHANNEL_COUNT) {
+        return;
+    }
+    bus_message_t message = {
+        .timestamp_us = timestamp_us,
+        .topic = BUS_TOPIC_FRAME,
+        .channel = channel,
+        .value = value,
+    };
+    bus_publish(&message);
+}
+
+void bus_publish_aggregates(const aggregate_result_t results[REGISTRY_CHANNEL_COUNT],
+                            int64_t timestamp_us) {
+    // stamped with the end of the period, as a silent channel has no frame time of its own
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        bus_message_t message = {
+            .timestamp_us = timestamp_us,
+            .topic = BUS_TOPIC_AGGREGATE,
+            .channel = channel,
+            .aggregate = results[channel],
+        };
+        bus_publish(&message);
+    }
+}
+
+bool bus_receive(bus_subscriber_t *subscriber, bus_message_t *message) {
+    return spsc_pop(&subscriber->ring, message);
+}
+
+uint32_t bus_subscriber_count(void) {
+    return atomic_load_explicit(&bus_ctx.count, memory_order_acquire);
+}
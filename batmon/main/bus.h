@@ -0,0 +1,63 @@
+#ifndef BUS_H
+#define BUS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "aggregate.h"
+#include "registry.h"
+#include "spsc.h"
+
+#define BUS_SUBSCRIBER_COUNT 16
+
+typedef enum {
+    BUS_TOPIC_FRAME = 0, // each registered tinbus frame as it is received
+    BUS_TOPIC_AGGREGATE, // each channel's aggregate at the end of every period
+    BUS_TOPIC_COUNT,
+} bus_topic_t;
+
+#define BUS_TOPIC_MASK(topic) (1UL << (topic))
+
+typedef struct bus_message_t {
+    int64_t timestamp_us;
+    uint8_t topic;
+    uint8_t channel;
+    union {
+        int16_t value;                // BUS_TOPIC_FRAME, raw frame value
+        aggregate_result_t aggregate; // BUS_TOPIC_AGGREGATE
+    };
+} bus_message_t;
+
+typedef struct bus_subscriber_t {
+    spsc_t ring;
+    const char *name;
+    uint32_t topics;     // BUS_TOPIC_MASK() of the topics wanted
+    int64_t interval_us; // minimum spacing per topic and channel, 0 for every message
+    int64_t next_us[BUS_TOPIC_COUNT][REGISTRY_CHANNEL_COUNT];
+    uint32_t delivered;
+    uint32_t limited; // skipped by the rate limit
+    uint32_t dropped; // skipped because the subscriber's ring was full
+} bus_subscriber_t;
+
+/* Storage for a subscriber's ring, count must be a power of two */
+#define BUS_STORAGE_DEFINE(name, count) static bus_message_t name[count]
+
+void bus_init(void);
+bus_subscriber_t *bus_subscribe(const char *name, uint32_t topics, int64_t interval_us,
+                                bus_message_t *storage, uint32_t count);
+void bus_publish(const bus_message_t *message);
+void bus_publish_frame(uint8_t channel, int16_t value, int64_t timestamp_us);
+void bus_publish_aggregates(const aggregate_result_t results[REGISTRY_CHANNEL_COUNT],
+                            int64_t timestamp_us);
+bool bus_receive(bus_subscriber_t *subscriber, bus_message_t *message);
+uint32_t bus_subscriber_count(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* BUS_H_ */
@@ -0,0 +1,145 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cbor.h"
+
+/*
+ * Streaming CBOR (RFC 8949) writer with the same calls as the JSON writer. Objects and arrays
+ * are written with indefinite lengths so nothing has to be counted ahead, and every item goes
+ * straight to the chunk buffer. Integers take the shortest head that holds them. Fixed point
+ * values are sent as single precision floats when that reads back as the same fixed point
+ * value, and as doubles otherwise, so there is no text formatting at all.
+ */
+
+#define CBOR_MAJOR_UNSIGNED 0
+#define CBOR_MAJOR_NEGATIVE 1
+#define CBOR_MAJOR_TEXT 3
+#define CBOR_INDEFINITE_ARRAY 0x9F
+#define CBOR_INDEFINITE_MAP 0xBF
+#define CBOR_FALSE 0xF4
+#define CBOR_TRUE 0xF5
+#define CBOR_NULL 0xF6
+#define CBOR_FLOAT32 0xFA
+#define CBOR_FLOAT64 0xFB
+#define CBOR_BREAK 0xFF
+
+void cbor_init(cbor_t *cbor, chunk_t *chunk) {
+    cbor->chunk = chunk;
+    cbor->depth = 0;
+}
+
+static void cbor_big_endian(cbor_t *cbor, uint8_t initial, uint64_t value, uint8_t size) {
+    uint8_t bytes[9];
+    bytes[0] = initial;
+    for (uint8_t i = 0; i < size; i++) {
+        bytes[size - i] = (uint8_t)(value >> (8 * i));
+    }
+    chunk_write(cbor->chunk, bytes, size + 1);
+}
+
+static void cbor_head(cbor_t *cbor, uint8_t major, uint64_t value) {
+    major <<= 5;
+    if (value < 24) {
+        uint8_t byte = major | (uint8_t)value;
+        chunk_write(cbor->chunk, &byte, 1);
+    } else if (value <= UINT8_MAX) {
+        cbor_big_endian(cbor, major | 24, value, 1);
+    } else if (value <= UINT16_MAX) {
+        cbor_big_endian(cbor, major | 25, value, 2);
+    } else if (value <= UINT32_MAX) {
+        cbor_big_endian(cbor, major | 26, value, 4);
+    } else {
+        cbor_big_endian(cbor, major | 27, value, 8);
+    }
+}
+
+static void cbor_text(cbor_t *cbor, const char *text) {
+    size_t length = strlen(text);
+    cbor_head(cbor, CBOR_MAJOR_TEXT, length);
+    chunk_write(cbor->chunk, text, length);
+}
+
+static void cbor_key(cbor_t *cbor, const char *key) {
+    if (key) {
+        cbor_text(cbor, key);
+    }
+}
+
+static void cbor_byte(cbor_t *cbor, uint8_t byte) {
+    chunk_write(cbor->chunk, &byte, 1);
+}
+
+void cbor_object_begin(cbor_t *cbor, const char *key) {
+    cbor_key(cbor, key);
+    cbor_byte(cbor, CBOR_INDEFINITE_MAP);
+    cbor->depth++;
+}
+
+void cbor_object_end(cbor_t *cbor) {
+    cbor_byte(cbor, CBOR_BREAK);
+    cbor->depth--;
+}
+
+void cbor_array_begin(cbor_t *cbor, const char *key) {
+    cbor_key(cbor, key);
+    cbor_byte(cbor, CBOR_INDEFINITE_ARRAY);
+    cbor->depth++;
+}
+
+void cbor_array_end(cbor_t *cbor) {
+    cbor_byte(cbor, CBOR_BREAK);
+    cbor->depth--;
+}
+
+void cbor_string(cbor_t *cbor, const char *key, const char *value) {
+    cbor_key(cbor, key);
+    cbor_text(cbor, value);
+}
+
+void cbor_int(cbor_t *cbor, const char *key, int64_t value) {
+    cbor_key(cbor, key);
+    if (value >= 0) {
+        cbor_head(cbor, CBOR_MAJOR_UNSIGNED, (uint64_t)value);
+    } else {
+        cbor_head(cbor, CBOR_MAJOR_NEGATIVE, (uint64_t)(-1 - value));
+    }
+}
+
+void cbor_fixed(cbor_t *cbor, const char *key, int64_t value, uint8_t decimals) {
+    cbor_key(cbor, key);
+    int64_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    float single = (float)value / (float)scale;
+    float back = single * (float)scale;
+    if ((int64_t)(back < 0 ? back - 0.5f : back + 0.5f) == value) {
+        uint32_t bits;
+        memcpy(&bits, &single, sizeof(bits));
+        cbor_big_endian(cbor, CBOR_FLOAT32, bits, 4);
+    } else {
+        double full = (double)value / (double)scale;
+        uint64_t bits;
+        memcpy(&bits, &full, sizeof(bits));
+        cbor_big_endian(cbor, CBOR_FLOAT64, bits, 8);
+    }
+}
+
+void cbor_bool(cbor_t *cbor, const char *key, bool value) {
+    cbor_key(cbor, key);
+    cbor_byte(cbor, value ? CBOR_TRUE : CBOR_FALSE);
+}
+
+void cbor_null(cbor_t *cbor, const char *key) {
+    cbor_key(cbor, key);
+    cbor_byte(cbor, CBOR_NULL);
+}
+
+/* Send whatever is left in the chunk buffer, false if any part of the item was lost */
+bool cbor_finish(cbor_t *cbor) {
+    if (cbor->depth) {
+        cbor->chunk->failed = true;
+    }
+    return chunk_flush(cbor->chunk);
+}
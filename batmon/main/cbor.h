@@ -0,0 +1,34 @@
+#ifndef CBOR_H
+#define CBOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chunk.h"
+
+typedef struct cbor_t {
+    chunk_t *chunk;
+    uint8_t depth;
+} cbor_t;
+
+void cbor_init(cbor_t *cbor, chunk_t *chunk);
+void cbor_object_begin(cbor_t *cbor, const char *key);
+void cbor_object_end(cbor_t *cbor);
+void cbor_array_begin(cbor_t *cbor, const char *key);
+void cbor_array_end(cbor_t *cbor);
+void cbor_string(cbor_t *cbor, const char *key, const char *value);
+void cbor_int(cbor_t *cbor, const char *key, int64_t value);
+void cbor_fixed(cbor_t *cbor, const char *key, int64_t value, uint8_t decimals);
+void cbor_bool(cbor_t *cbor, const char *key, bool value);
+void cbor_null(cbor_t *cbor, const char *key);
+bool cbor_finish(cbor_t *cbor);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* CBOR_H_ */
@@ -0,0 +1,62 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chunk.h"
+
+/*
+ * Fixed size output buffer for streamed responses. Writers append to the buffer and it is sent
+ * on whenever it fills, so the memory used by a response is the buffer whatever its length.
+ * The first failed send, or a formatted value too long to write, latches, which lets an encoder
+ * run to the end without checking every call and report the failure once.
+ */
+
+void chunk_init(chunk_t *chunk, char *buffer, size_t size, chunk_send_t send, void *context) {
+    chunk->buffer = buffer;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->send = send;
+    chunk->context = context;
+    chunk->total = 0;
+    chunk->failed = false;
+}
+
+bool chunk_flush(chunk_t *chunk) {
+    if (!chunk->failed && chunk->used) {
+        chunk->failed = !chunk->send(chunk->context, chunk->buffer, chunk->used);
+    }
+    chunk->used = 0;
+    return !chunk->failed;
+}
+
+bool chunk_write(chunk_t *chunk, const void *data, size_t size) {
+    const char *bytes = data;
+    while (size && !chunk->failed) {
+        size_t space = chunk->size - chunk->used;
+        size_t length = size < space ? size : space;
+        memcpy(&chunk->buffer[chunk->used], bytes, length);
+        chunk->used += length;
+        chunk->total += length;
+        bytes += length;
+        size -= length;
+        if (chunk->used == chunk->size) {
+            chunk_flush(chunk);
+        }
+    }
+    return !chunk->failed;
+}
+
+bool chunk_printf(chunk_t *chunk, const char *format, ...) {
+    char text[64]; // enough for any number, longer text should use chunk_write()
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if ((length < 0) || ((size_t)length >= sizeof(text))) {
+        chunk->failed = true; // a truncated value would corrupt the output, so fail it
+        return false;
+    }
+    return chunk_write(chunk, text, length);
+}
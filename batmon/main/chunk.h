@@ -0,0 +1,34 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Send size bytes on, returning false to abandon the response */
+typedef bool (*chunk_send_t)(void *context, const char *data, size_t size);
+
+typedef struct chunk_t {
+    char *buffer;
+    size_t size;
+    size_t used;
+    chunk_send_t send;
+    void *context;
+    uint32_t total; // bytes accepted so far
+    bool failed;    // a send failed, everything after it is discarded
+} chunk_t;
+
+void chunk_init(chunk_t *chunk, char *buffer, size_t size, chunk_send_t send, void *context);
+bool chunk_write(chunk_t *chunk, const void *data, size_t size);
+bool chunk_printf(chunk_t *chunk, const char *format, ...) __attribute__((format(printf, 2, 3)));
+bool chunk_flush(chunk_t *chunk);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* CHUNK_H_ */
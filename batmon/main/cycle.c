@@ -0,0 +1,171 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "aggregate.h"
+#include "cycle.h"
+#include "registry.h"
+#include "soc.h"
+
+/*
+ * Splits the current stream into charge, discharge and rest phases. A phase is entered when
+ * the current passes the enter threshold and left only when it falls back inside the exit
+ * threshold, so noise around a threshold does not chatter. Charge and energy per phase are the
+ * difference of the coulomb counter totals at its ends, so cycle_add() must follow soc_add()
+ * and power_add().
+ *
+ * Completed phases are kept for months in a storage ring of their own, so they are also stamped
+ * with the wall clock when it has been set: the microsecond times count from boot.
+ */
+
+#define CYCLE_ENTER_MA 1000
+#define CYCLE_EXIT_MA 500
+#define CYCLE_MIN_DURATION_US (60 * 1000000LL) // shorter phases are not reported
+#define CYCLE_CLOCK_SET_S 1451606400LL          // 2016, any earlier time is a clock not yet set
+
+typedef struct cycle_ctx_t {
+    cycle_phase_t phase;
+    int32_t voltage_mv;
+    bool have_voltage;
+    cycle_result_t current; // phase in progress
+    soc_result_t start;     // coulomb counter totals when it began
+    cycle_result_t completed;
+} cycle_ctx_t;
+
+static cycle_ctx_t cycle_ctx;
+
+static cycle_phase_t cycle_next_phase(cycle_phase_t phase, int32_t current_ma) {
+    switch (phase) {
+        case CYCLE_CHARGE:
+            if (current_ma >= CYCLE_EXIT_MA) {
+                return CYCLE_CHARGE;
+            }
+            break;
+        case CYCLE_DISCHARGE:
+            if (current_ma <= -CYCLE_EXIT_MA) {
+                return CYCLE_DISCHARGE;
+            }
+            break;
+        case CYCLE_REST:
+            break;
+    }
+    if (current_ma >= CYCLE_ENTER_MA) {
+        return CYCLE_CHARGE;
+    }
+    if (current_ma <= -CYCLE_ENTER_MA) {
+        return CYCLE_DISCHARGE;
+    }
+    return CYCLE_REST;
+}
+
+static void cycle_start(cycle_ctx_t *ctx, cycle_phase_t phase, int64_t timestamp_us) {
+    memset(&ctx->current, 0, sizeof(ctx->current));
+    ctx->phase = phase;
+    ctx->current.phase = phase;
+    ctx->current.start_us = timestamp_us;
+    ctx->current.min_voltage_mv = ctx->have_voltage ? ctx->voltage_mv : INT32_MAX;
+    ctx->current.max_voltage_mv = ctx->have_voltage ? ctx->voltage_mv : INT32_MIN;
+    soc_get(&ctx->start);
+}
+
+/* Close the phase in progress, returning true if it is worth reporting */
+static bool cycle_finish(cycle_ctx_t *ctx, int64_t timestamp_us) {
+    cycle_result_t *result = &ctx->current;
+    soc_result_t end;
+    soc_get(&end);
+    result->end_us = timestamp_us;
+    time_t now = time(NULL);
+    result->end_time_s = now >= CYCLE_CLOCK_SET_S ? (int64_t)now : 0;
+    if (result->phase == CYCLE_CHARGE) {
+        result->charge_uah = end.charge_in_uah - ctx->start.charge_in_uah;
+        result->energy_uwh = end.energy_in_uwh - ctx->start.energy_in_uwh;
+    } else {
+        result->charge_uah = end.charge_out_uah - ctx->start.charge_out_uah;
+        result->energy_uwh = end.energy_out_uwh - ctx->start.energy_out_uwh;
+    }
+    if ((result->phase == CYCLE_REST) ||
+        (result->end_us - result->start_us < CYCLE_MIN_DURATION_US)) {
+        return false;
+    }
+    ctx->completed = *result;
+    return true;
+}
+
+void cycle_init(void) {
+    memset(&cycle_ctx, 0, sizeof(cycle_ctx));
+    cycle_start(&cycle_ctx, CYCLE_REST, 0);
+}
+
+/* Returns true when the frame completed a charge or discharge phase */
+bool cycle_add(uint8_t device_id, int16_t value, int64_t timestamp_us) {
+    cycle_ctx_t *ctx = &cycle_ctx;
+    uint8_t channel = registry_channel(device_id);
+    if (channel == REGISTRY_CHANNEL_VOLTAGE) {
+        ctx->voltage_mv = aggregate_scale(channel, value, 1);
+        ctx->have_voltage = true;
+        if (ctx->voltage_mv < ctx->current.min_voltage_mv) {
+            ctx->current.min_voltage_mv = ctx->voltage_mv;
+        }
+        if (ctx->voltage_mv > ctx->current.max_voltage_mv) {
+            ctx->current.max_voltage_mv = ctx->voltage_mv;
+        }
+        return false;
+    }
+    if (channel != REGISTRY_CHANNEL_CURRENT) {
+        return false;
+    }
+    int32_t current_ma = aggregate_scale(channel, value, 1);
+    bool completed = false;
+    cycle_phase_t phase = cycle_next_phase(ctx->phase, current_ma);
+    if (phase != ctx->phase) {
+        completed = cycle_finish(ctx, timestamp_us);
+        cycle_start(ctx, phase, timestamp_us);
+    }
+    int32_t magnitude = current_ma < 0 ? -current_ma : current_ma;
+    if (magnitude > ctx->current.peak_current_ma) {
+        ctx->current.peak_current_ma = magnitude;
+    }
+    return completed;
+}
+
+/* The last completed charge or discharge phase */
+void cycle_get(cycle_result_t *result) { *result = cycle_ctx.completed; }
+
+cycle_phase_t cycle_phase(void) { return cycle_ctx.phase; }
+
+/* Serialise as "Y,C|D,start_us,end_us,charge_uah,energy_uwh,min_mv,max_mv,peak_ma,end_time_s" */
+int cycle_serialise(char *buffer, size_t size, const cycle_result_t *result) {
+    return snprintf(buffer, size, CYCLE_RECORD_TAG ",%c,%lld,%lld,%lld,%lld,%ld,%ld,%ld,%lld",
+                    result->phase == CYCLE_CHARGE ? 'C' : 'D', (long long)result->start_us,
+                    (long long)result->end_us, (long long)result->charge_uah,
+                    (long long)result->energy_uwh, (long)result->min_voltage_mv,
+                    (long)result->max_voltage_mv, (long)result->peak_current_ma,
+                    (long long)result->end_time_s);
+}
+
+/* Read back a record written by cycle_serialise(), false if it is not one */
+bool cycle_parse(const char *record, cycle_result_t *result) {
+    char phase;
+    long long start_us, end_us, charge_uah, energy_uwh, end_time_s;
+    long min_mv, max_mv, peak_ma;
+    if ((sscanf(record, CYCLE_RECORD_TAG ",%c,%lld,%lld,%lld,%lld,%ld,%ld,%ld,%lld", &phase,
+                &start_us, &end_us, &charge_uah, &energy_uwh, &min_mv, &max_mv, &peak_ma,
+                &end_time_s) != 9) ||
+        ((phase != 'C') && (phase != 'D'))) {
+        return false;
+    }
+    *result = (cycle_result_t){
+        .phase = phase == 'C' ? CYCLE_CHARGE : CYCLE_DISCHARGE,
+        .start_us = start_us,
+        .end_us = end_us,
+        .charge_uah = charge_uah,
+        .energy_uwh = energy_uwh,
+        .min_voltage_mv = min_mv,
+        .max_voltage_mv = max_mv,
+        .peak_current_ma = peak_ma,
+        .end_time_s = end_time_s,
+    };
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef CYCLE_H
+#define CYCLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CYCLE_RECORD_TAG "Y"
+
+typedef enum {
+    CYCLE_REST = 0,
+    CYCLE_CHARGE,
+    CYCLE_DISCHARGE,
+} cycle_phase_t;
+
+typedef struct cycle_result_t {
+    cycle_phase_t phase;
+    int64_t start_us;
+    int64_t end_us;
+    int64_t charge_uah; // magnitude of the charge moved during the phase
+    int64_t energy_uwh;
+    int32_t min_voltage_mv;
+    int32_t max_voltage_mv;
+    int32_t peak_current_ma; // largest magnitude seen during the phase
+    int64_t end_time_s;      // Unix time the phase ended, zero if the clock was not set
+} cycle_result_t;
+
+void cycle_init(void);
+bool cycle_add(uint8_t device_id, int16_t value, int64_t timestamp_us);
+void cycle_get(cycle_result_t *result);
+cycle_phase_t cycle_phase(void);
+int cycle_serialise(char *buffer, size_t size, const cycle_result_t *result);
+bool cycle_parse(const char *record, cycle_result_t *result);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* CYCLE_H_ */
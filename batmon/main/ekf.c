@@ -0,0 +1,157 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "aggregate.h"
+#include "ekf.h"
+#include "registry.h"
+
+/*
+ * Extended Kalman filter state of charge estimator. The state is x = [soc, vrc] for a battery
+ * modelled as an open circuit voltage source OCV(soc), a series resistance r0 and one RC pair:
+ *
+ *   soc' = soc + eta * i * dt / (3600 * capacity)
+ *   vrc' = vrc * exp(-dt / tau) + r1 * (1 - exp(-dt / tau)) * i
+ *   v    = OCV(soc) + vrc + r0 * i
+ *
+ * Current frames run the predict step and voltage frames the measurement update. All the
+ * matrices are 2x2 or smaller and held in static storage, so each frame costs a fixed time.
+ */
+
+#define EKF_OCV_POINTS 11
+
+// resting voltage of a 12 V LiFePO4 battery at 0, 10, ... 100 % state of charge
+static const float ekf_ocv_table[EKF_OCV_POINTS] = {
+    10.00f, 12.00f, 12.80f, 12.90f, 13.00f, 13.05f, 13.10f, 13.15f, 13.20f, 13.30f, 13.60f,
+};
+
+static const ekf_config_t ekf_default_config = {
+    .capacity_ah = 100.0f,
+    .charge_efficiency = 0.98f,
+    .r0_ohm = 0.010f,
+    .r1_ohm = 0.005f,
+    .tau_s = 30.0f,
+    .initial_soc = 0.5f,
+    .initial_soc_variance = 0.25f,
+    .process_noise_soc = 1e-8f,
+    .process_noise_vrc = 1e-6f,
+    .measurement_noise_v = 4e-4f,
+    .max_gap_us = 10 * 1000000LL,
+};
+
+typedef struct ekf_ctx_t {
+    ekf_config_t config;
+    float soc;
+    float vrc;
+    float p[2][2];
+    float current_a;
+    float residual_v;
+    int64_t current_timestamp_us;
+    int64_t timestamp_us;
+    bool have_current;
+} ekf_ctx_t;
+
+static ekf_ctx_t ekf_ctx;
+
+static float ekf_clamp(float value, float min, float max) {
+    return value < min ? min : (value > max ? max : value);
+}
+
+/* Piecewise linear OCV lookup, returning the slope in dv_dsoc */
+static float ekf_ocv_slope(float soc, float *dv_dsoc) {
+    float position = ekf_clamp(soc, 0.0f, 1.0f) * (EKF_OCV_POINTS - 1);
+    int index = (int)position;
+    if (index >= EKF_OCV_POINTS - 1) {
+        index = EKF_OCV_POINTS - 2;
+    }
+    float slope = ekf_ocv_table[index + 1] - ekf_ocv_table[index];
+    *dv_dsoc = slope * (EKF_OCV_POINTS - 1);
+    return ekf_ocv_table[index] + slope * (position - index);
+}
+
+float ekf_ocv(float soc) {
+    float dv_dsoc;
+    return ekf_ocv_slope(soc, &dv_dsoc);
+}
+
+static void ekf_predict(ekf_ctx_t *ctx, float dt) {
+    const ekf_config_t *config = &ctx->config;
+    float current = ctx->current_a;
+    float eta = current > 0 ? config->charge_efficiency : 1.0f;
+    float decay = expf(-dt / config->tau_s);
+
+    ctx->soc += eta * current * dt / (3600.0f * config->capacity_ah);
+    ctx->vrc = ctx->vrc * decay + config->r1_ohm * (1.0f - decay) * current;
+
+    // P = F P F' + Q with F = [1 0; 0 decay]
+    float(*p)[2] = ctx->p;
+    p[0][0] += config->process_noise_soc * dt;
+    p[0][1] *= decay;
+    p[1][0] *= decay;
+    p[1][1] = p[1][1] * decay * decay + config->process_noise_vrc * dt;
+}
+
+static void ekf_update(ekf_ctx_t *ctx, float voltage) {
+    const ekf_config_t *config = &ctx->config;
+    float h0;
+    float predicted = ekf_ocv_slope(ctx->soc, &h0) + ctx->vrc + config->r0_ohm * ctx->current_a;
+    float(*p)[2] = ctx->p;
+
+    // H = [h0 1], S = H P H' + R, K = P H' / S
+    float ph0 = p[0][0] * h0 + p[0][1];
+    float ph1 = p[1][0] * h0 + p[1][1];
+    float s = h0 * ph0 + ph1 + config->measurement_noise_v;
+    float k0 = ph0 / s;
+    float k1 = ph1 / s;
+
+    ctx->residual_v = voltage - predicted;
+    ctx->soc = ekf_clamp(ctx->soc + k0 * ctx->residual_v, 0.0f, 1.0f);
+    ctx->vrc += k1 * ctx->residual_v;
+
+    // P = (I - K H) P
+    float p00 = p[0][0] - k0 * ph0;
+    float p01 = p[0][1] - k0 * (h0 * p[0][1] + p[1][1]);
+    float p10 = p[1][0] - k1 * ph0;
+    float p11 = p[1][1] - k1 * (h0 * p[0][1] + p[1][1]);
+    p[0][0] = p00;
+    p[0][1] = p01;
+    p[1][0] = p10;
+    p[1][1] = p11;
+}
+
+void ekf_init(const ekf_config_t *config) {
+    memset(&ekf_ctx, 0, sizeof(ekf_ctx));
+    ekf_ctx.config = config ? *config : ekf_default_config;
+    ekf_ctx.soc = ekf_ctx.config.initial_soc;
+    ekf_ctx.p[0][0] = ekf_ctx.config.initial_soc_variance;
+    ekf_ctx.p[1][1] = ekf_ctx.config.measurement_noise_v;
+}
+
+void ekf_add(uint8_t device_id, int16_t value, int64_t timestamp_us) {
+    ekf_ctx_t *ctx = &ekf_ctx;
+    uint8_t channel = registry_channel(device_id);
+    if (channel == REGISTRY_CHANNEL_CURRENT) {
+        int64_t dt_us = timestamp_us - ctx->current_timestamp_us;
+        if (ctx->have_current && (dt_us > 0) && (dt_us <= ctx->config.max_gap_us)) {
+            ekf_predict(ctx, dt_us * 1e-6f); // the previous current held over the interval
+        }
+        ctx->current_a = aggregate_scale(channel, value, 1) * 0.001f;
+        ctx->current_timestamp_us = timestamp_us;
+        ctx->have_current = true;
+    } else if ((channel == REGISTRY_CHANNEL_VOLTAGE) && ctx->have_current) {
+        ekf_update(ctx, aggregate_scale(channel, value, 1) * 0.001f);
+    } else {
+        return;
+    }
+    ctx->timestamp_us = timestamp_us;
+}
+
+void ekf_get(ekf_result_t *result) {
+    const ekf_ctx_t *ctx = &ekf_ctx;
+    result->timestamp_us = ctx->timestamp_us;
+    result->soc_permille = lrintf(ctx->soc * 1000.0f);
+    result->soc_stddev_permille = lrintf(sqrtf(ctx->p[0][0] > 0 ? ctx->p[0][0] : 0) * 1000.0f);
+    result->vrc_mv = lrintf(ctx->vrc * 1000.0f);
+    result->residual_mv = lrintf(ctx->residual_v * 1000.0f);
+}
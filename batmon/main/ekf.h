@@ -0,0 +1,41 @@
+#ifndef EKF_H
+#define EKF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef struct ekf_config_t {
+    float capacity_ah;
+    float charge_efficiency; // applied to charging current only
+    float r0_ohm;            // series resistance
+    float r1_ohm;            // polarisation resistance of the RC pair
+    float tau_s;             // time constant of the RC pair
+    float initial_soc;       // 0.0 to 1.0
+    float initial_soc_variance;
+    float process_noise_soc; // variance added per second
+    float process_noise_vrc;
+    float measurement_noise_v; // variance of a voltage frame
+    int64_t max_gap_us;        // longer gaps between current frames are not predicted across
+} ekf_config_t;
+
+typedef struct ekf_result_t {
+    int64_t timestamp_us; // last frame processed
+    int16_t soc_permille;
+    int16_t soc_stddev_permille;
+    int32_t vrc_mv;      // voltage across the RC pair
+    int32_t residual_mv; // measured minus predicted voltage at the last update
+} ekf_result_t;
+
+void ekf_init(const ekf_config_t *config);
+void ekf_add(uint8_t device_id, int16_t value, int64_t timestamp_us);
+void ekf_get(ekf_result_t *result);
+float ekf_ocv(float soc);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* EKF_H_ */
@@ -0,0 +1,102 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "emit.h"
+
+/*
+ * One set of calls for building a response in whichever encoding the client asked for. Each
+ * call is passed on to the JSON or CBOR writer, which have the same shape, so a handler is
+ * written once and content negotiation only picks the format.
+ */
+
+const char *emit_content_type(emit_format_t format) {
+    return format == EMIT_CBOR ? "application/cbor" : "application/json";
+}
+
+void emit_init(emit_t *emit, emit_format_t format, chunk_t *chunk) {
+    emit->format = format;
+    if (format == EMIT_CBOR) {
+        cbor_init(&emit->cbor, chunk);
+    } else {
+        json_init(&emit->json, chunk);
+    }
+}
+
+void emit_object_begin(emit_t *emit, const char *key) {
+    if (emit->format == EMIT_CBOR) {
+        cbor_object_begin(&emit->cbor, key);
+    } else {
+        json_object_begin(&emit->json, key);
+    }
+}
+
+void emit_object_end(emit_t *emit) {
+    if (emit->format == EMIT_CBOR) {
+        cbor_object_end(&emit->cbor);
+    } else {
+        json_object_end(&emit->json);
+    }
+}
+
+void emit_array_begin(emit_t *emit, const char *key) {
+    if (emit->format == EMIT_CBOR) {
+        cbor_array_begin(&emit->cbor, key);
+    } else {
+        json_array_begin(&emit->json, key);
+    }
+}
+
+void emit_array_end(emit_t *emit) {
+    if (emit->format == EMIT_CBOR) {
+        cbor_array_end(&emit->cbor);
+    } else {
+        json_array_end(&emit->json);
+    }
+}
+
+void emit_string(emit_t *emit, const char *key, const char *value) {
+    if (emit->format == EMIT_CBOR) {
+        cbor_string(&emit->cbor, key, value);
+    } else {
+        json_string(&emit->json, key, value);
+    }
+}
+
+void emit_int(emit_t *emit, const char *key, int64_t value) {
+    if (emit->format == EMIT_CBOR) {
+        cbor_int(&emit->cbor, key, value);
+    } else {
+        json_int(&emit->json, key, value);
+    }
+}
+
+void emit_fixed(emit_t *emit, const char *key, int64_t value, uint8_t decimals) {
+    if (emit->format == EMIT_CBOR) {
+        cbor_fixed(&emit->cbor, key, value, decimals);
+    } else {
+        json_fixed(&emit->json, key, value, decimals);
+    }
+}
+
+void emit_bool(emit_t *emit, const char *key, bool value) {
+    if (emit->format == EMIT_CBOR) {
+        cbor_bool(&emit->cbor, key, value);
+    } else {
+        json_bool(&emit->json, key, value);
+    }
+}
+
+void emit_null(emit_t *emit, const char *key) {
+    if (emit->format == EMIT_CBOR) {
+        cbor_null(&emit->cbor, key);
+    } else {
+        json_null(&emit->json, key);
+    }
+}
+
+bool emit_finish(emit_t *emit) {
+    if (emit->format == EMIT_CBOR) {
+        return cbor_finish(&emit->cbor);
+    }
+    return json_finish(&emit->json);
+}
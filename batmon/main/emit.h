@@ -0,0 +1,45 @@
+#ifndef EMIT_H
+#define EMIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cbor.h"
+#include "chunk.h"
+#include "json.h"
+
+typedef enum {
+    EMIT_JSON = 0,
+    EMIT_CBOR,
+} emit_format_t;
+
+typedef struct emit_t {
+    emit_format_t format;
+    union {
+        json_t json;
+        cbor_t cbor;
+    };
+} emit_t;
+
+const char *emit_content_type(emit_format_t format);
+void emit_init(emit_t *emit, emit_format_t format, chunk_t *chunk);
+void emit_object_begin(emit_t *emit, const char *key);
+void emit_object_end(emit_t *emit);
+void emit_array_begin(emit_t *emit, const char *key);
+void emit_array_end(emit_t *emit);
+void emit_string(emit_t *emit, const char *key, const char *value);
+void emit_int(emit_t *emit, const char *key, int64_t value);
+void emit_fixed(emit_t *emit, const char *key, int64_t value, uint8_t decimals);
+void emit_bool(emit_t *emit, const char *key, bool value);
+void emit_null(emit_t *emit, const char *key);
+bool emit_finish(emit_t *emit);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* EMIT_H_ */
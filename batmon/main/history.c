@@ -0,0 +1,402 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aggregate.h"
+#include "history.h"
+
+/*
+ * Time range queries over the logged stream records. Records are fed in the order they were
+ * written, normally from a storage cursor, and must all come from the current boot, as their
+ * timestamps count from boot and earlier boots would fall in the same range. Those in range are
+ * parsed, averaged into buckets of the requested step and written straight to the chunk buffer as
+ * JSON, CBOR, CSV or packed binary. Only the open bucket is held, so memory does not grow with the
+ * length of the query.
+ *
+ * With max_points the points are then thinned by Largest-Triangle-Three-Buckets in the same
+ * pass. The span from the first point to to_us is cut into max_points - 2 equal time buckets
+ * and from each the point making the largest triangle with the point sent from the bucket
+ * before and the mean of the bucket after is sent, which keeps peaks and troughs. Exact LTTB
+ * would need every point of a bucket until the next one has been seen; here a bucket keeps
+ * only its first, last, lowest and highest points as candidates, which is where the largest
+ * triangle almost always lies, so memory stays constant. The shape followed is the first
+ * requested series, with the other series taken from the same points.
+ *
+ * Stream records are "stream,timestamp_us,value,..." with one milli-unit value for each channel
+ * of that stream in channel order, as written by batmon_write_record().
+ */
+
+bool history_series(const char *list, uint32_t *series) {
+    *series = 0;
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        bool found = false;
+        for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+            const char *name = registry_entry(channel)->name;
+            if ((strlen(name) == length) && (strncmp(name, list, length) == 0)) {
+                *series |= 1UL << channel;
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        list += length;
+        if (*list == ',') {
+            list++;
+        }
+    }
+    return *series != 0;
+}
+
+const char *history_content_type(history_format_t format) {
+    switch (format) {
+        case HISTORY_CSV:
+            return "text/csv";
+        case HISTORY_BINARY:
+            return "application/octet-stream";
+        case HISTORY_CBOR:
+            return emit_content_type(EMIT_CBOR);
+        default:
+            return "application/json";
+    }
+}
+
+/* Parse a decimal with up to three places, as written by aggregate_format_milli() */
+static bool history_parse_milli(const char **text, int32_t *value_milli) {
+    const char *c = *text;
+    bool negative = (*c == '-');
+    if (negative) {
+        c++;
+    }
+    if ((*c < '0') || (*c > '9')) {
+        return false;
+    }
+    int64_t value = 0;
+    while ((*c >= '0') && (*c <= '9')) {
+        value = value * 10 + (*c++ - '0');
+    }
+    int places = 0;
+    if (*c == '.') {
+        c++;
+        while ((*c >= '0') && (*c <= '9')) {
+            if (places < 3) {
+                value = value * 10 + (*c - '0');
+                places++;
+            }
+            c++;
+        }
+    }
+    for (; places < 3; places++) {
+        value *= 10;
+    }
+    *value_milli = (int32_t)(negative ? -value : value);
+    *text = c;
+    return true;
+}
+
+static void history_write_milli(history_t *history, int32_t value_milli) {
+    char text[16];
+    int length = aggregate_format_milli(text, sizeof(text), value_milli);
+    chunk_write(history->chunk, text, length);
+}
+
+static void history_write_le(history_t *history, uint64_t value, uint8_t size) {
+    uint8_t bytes[8];
+    for (uint8_t i = 0; i < size; i++) {
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    }
+    chunk_write(history->chunk, bytes, size);
+}
+
+/* Encode one point */
+static void history_write(history_t *history, const history_point_t *point) {
+    int64_t timestamp_us = point->timestamp_us;
+    history->points++;
+    switch (history->query.format) {
+        case HISTORY_CSV:
+            chunk_printf(history->chunk, "%" PRId64, timestamp_us);
+            break;
+        case HISTORY_BINARY:
+            history_write_le(history, (uint64_t)timestamp_us, 8);
+            break;
+        default:
+            emit_array_begin(&history->emit, NULL);
+            emit_int(&history->emit, NULL, timestamp_us);
+            break;
+    }
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        if ((history->query.series & (1UL << channel)) == 0) {
+            continue;
+        }
+        bool valid = (point->present >> channel) & 1;
+        switch (history->query.format) {
+            case HISTORY_CSV:
+                chunk_write(history->chunk, ",", 1);
+                if (valid) {
+                    history_write_milli(history, point->values[channel]);
+                }
+                break;
+            case HISTORY_BINARY:
+                history_write_le(history, (uint32_t)(valid ? point->values[channel] : INT32_MIN),
+                                 4);
+                break;
+            default:
+                if (valid) {
+                    emit_fixed(&history->emit, NULL, point->values[channel], 3);
+                } else {
+                    emit_null(&history->emit, NULL);
+                }
+                break;
+        }
+    }
+    if (history->query.format == HISTORY_CSV) {
+        chunk_write(history->chunk, "\n", 1);
+    } else if (history->query.format != HISTORY_BINARY) {
+        emit_array_end(&history->emit);
+    }
+}
+
+static void history_lttb_open(history_lttb_bucket_t *bucket, int64_t index) {
+    bucket->index = index;
+    bucket->sum_ms = 0;
+    bucket->sum_milli = 0;
+    bucket->count = 0;
+}
+
+static void history_lttb_add(history_lttb_t *lttb, history_lttb_bucket_t *bucket,
+                             const history_point_t *point) {
+    int32_t value = point->values[lttb->channel];
+    if (bucket->count == 0) {
+        for (int i = 0; i < HISTORY_LTTB_CANDIDATES; i++) {
+            bucket->candidates[i] = *point;
+        }
+    } else {
+        bucket->candidates[HISTORY_LTTB_LAST] = *point;
+        if (value < bucket->candidates[HISTORY_LTTB_MIN].values[lttb->channel]) {
+            bucket->candidates[HISTORY_LTTB_MIN] = *point;
+        }
+        if (value > bucket->candidates[HISTORY_LTTB_MAX].values[lttb->channel]) {
+            bucket->candidates[HISTORY_LTTB_MAX] = *point;
+        }
+    }
+    bucket->sum_ms += point->timestamp_us / 1000;
+    bucket->sum_milli += value;
+    bucket->count++;
+}
+
+/* Send the candidate making the largest triangle with the anchor and the point c */
+static void history_lttb_select(history_t *history, const history_lttb_bucket_t *bucket,
+                                int64_t c_ms, int64_t c_milli, bool skip_last) {
+    history_lttb_t *lttb = &history->lttb;
+    int64_t a_ms = lttb->anchor.timestamp_us / 1000;
+    int64_t a_milli = lttb->anchor.values[lttb->channel];
+    const history_point_t *best = NULL;
+    int64_t best_area = -1;
+    for (int i = 0; i < HISTORY_LTTB_CANDIDATES; i++) {
+        const history_point_t *point = &bucket->candidates[i];
+        if (skip_last && (point->timestamp_us == lttb->last.timestamp_us)) {
+            continue;
+        }
+        int64_t area = (a_ms - c_ms) * (point->values[lttb->channel] - a_milli) -
+                       (a_ms - point->timestamp_us / 1000) * (c_milli - a_milli);
+        area = area < 0 ? -area : area;
+        if (area > best_area) {
+            best_area = area;
+            best = point;
+        }
+    }
+    if (best) {
+        history_write(history, best);
+        lttb->anchor = *best;
+    }
+}
+
+static void history_lttb_point(history_t *history, const history_point_t *point) {
+    history_lttb_t *lttb = &history->lttb;
+    if ((point->present & (1UL << lttb->channel)) == 0) {
+        return;
+    }
+    if (!lttb->started) {
+        lttb->started = true;
+        lttb->start_us = point->timestamp_us;
+        lttb->anchor = *point;
+        lttb->last = *point;
+        history_write(history, point);
+        return;
+    }
+    if (point->timestamp_us <= lttb->last.timestamp_us) {
+        return; // out of order
+    }
+    int64_t span_us = history->query.to_us - lttb->start_us;
+    int64_t buckets = history->query.max_points - 2;
+    int64_t index = (point->timestamp_us - lttb->start_us) / (span_us / buckets + 1);
+    if (!lttb->have_current || (index != lttb->current.index)) {
+        if (lttb->have_previous) {
+            history_lttb_select(history, &lttb->previous,
+                                lttb->current.sum_ms / lttb->current.count,
+                                lttb->current.sum_milli / lttb->current.count, false);
+        }
+        lttb->previous = lttb->current;
+        lttb->have_previous = lttb->have_current;
+        history_lttb_open(&lttb->current, index);
+        lttb->have_current = true;
+    }
+    history_lttb_add(lttb, &lttb->current, point);
+    lttb->last = *point;
+}
+
+/* Select from the two buckets still open, then send the newest point */
+static void history_lttb_end(history_t *history) {
+    history_lttb_t *lttb = &history->lttb;
+    if (!lttb->have_current) {
+        return;
+    }
+    if (lttb->have_previous) {
+        history_lttb_select(history, &lttb->previous, lttb->current.sum_ms / lttb->current.count,
+                            lttb->current.sum_milli / lttb->current.count, false);
+    }
+    if (lttb->current.count > 1) {
+        history_lttb_select(history, &lttb->current, lttb->last.timestamp_us / 1000,
+                            lttb->last.values[lttb->channel], true);
+    }
+    history_write(history, &lttb->last);
+}
+
+/* Send a point, through LTTB if the query limits the number of points */
+static void history_emit(history_t *history, const history_point_t *point) {
+    if (history->query.max_points) {
+        history_lttb_point(history, point);
+    } else {
+        history_write(history, point);
+    }
+}
+
+static void history_close_bucket(history_t *history) {
+    if (!history->bucket_open) {
+        return;
+    }
+    history_point_t point = {.timestamp_us = history->bucket_us};
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        if (history->count[channel]) {
+            int64_t sum = history->sum[channel];
+            int64_t count = history->count[channel];
+            point.values[channel] = (int32_t)((sum + (sum < 0 ? -count / 2 : count / 2)) / count);
+            point.present |= 1UL << channel;
+        }
+        history->sum[channel] = 0;
+        history->count[channel] = 0;
+    }
+    history->bucket_open = false;
+    history_emit(history, &point);
+}
+
+void history_begin(history_t *history, const history_query_t *query, chunk_t *chunk) {
+    memset(history, 0, sizeof(history_t));
+    history->query = *query;
+    history->chunk = chunk;
+    if (query->max_points) {
+        uint32_t max_points = query->max_points;
+        max_points = max_points < HISTORY_LTTB_MIN_POINTS ? HISTORY_LTTB_MIN_POINTS : max_points;
+        max_points = max_points > HISTORY_LTTB_MAX_POINTS ? HISTORY_LTTB_MAX_POINTS : max_points;
+        history->query.max_points = max_points;
+        while ((history->lttb.channel < REGISTRY_CHANNEL_COUNT - 1) &&
+               !(query->series & (1UL << history->lttb.channel))) {
+            history->lttb.channel++;
+        }
+    }
+    if (query->format == HISTORY_CSV) {
+        chunk_write(chunk, "timestamp_us", 12);
+        for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+            if (query->series & (1UL << channel)) {
+                chunk_write(chunk, ",", 1);
+                chunk_write(chunk, registry_entry(channel)->name,
+                            strlen(registry_entry(channel)->name));
+            }
+        }
+        chunk_write(chunk, "\n", 1);
+    } else if (query->format != HISTORY_BINARY) {
+        emit_init(&history->emit, query->format == HISTORY_CBOR ? EMIT_CBOR : EMIT_JSON, chunk);
+        emit_object_begin(&history->emit, NULL);
+        emit_int(&history->emit, "from_us", query->from_us);
+        emit_int(&history->emit, "to_us", query->to_us);
+        emit_int(&history->emit, "step_us", query->step_us);
+        emit_int(&history->emit, "max_points", history->query.max_points);
+        emit_array_begin(&history->emit, "series");
+        for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+            if (query->series & (1UL << channel)) {
+                emit_string(&history->emit, NULL, registry_entry(channel)->name);
+            }
+        }
+        emit_array_end(&history->emit);
+        emit_array_begin(&history->emit, "points");
+    }
+}
+
+void history_add(history_t *history, const char *record) {
+    if ((*record < '0') || (*record > '9')) {
+        return; // not a stream record
+    }
+    char *end;
+    long stream = strtol(record, &end, 10);
+    if ((*end != ',') || (stream >= REGISTRY_STREAM_COUNT)) {
+        return;
+    }
+    int64_t timestamp_us = strtoll(end + 1, &end, 10);
+    if ((timestamp_us < history->query.from_us) || (timestamp_us > history->query.to_us)) {
+        return;
+    }
+    history_point_t point = {.timestamp_us = timestamp_us};
+    const char *field = end;
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        if (registry_entry(channel)->stream != stream) {
+            continue;
+        }
+        if (*field != ',') {
+            return; // truncated record
+        }
+        field++;
+        if (!history_parse_milli(&field, &point.values[channel])) {
+            return;
+        }
+        point.present |= 1UL << channel;
+    }
+    history->records++;
+
+    if (history->query.step_us <= 0) {
+        point.present &= history->query.series;
+        history_emit(history, &point);
+        return;
+    }
+    int64_t bucket_us = timestamp_us - (timestamp_us % history->query.step_us);
+    if (history->bucket_open && (bucket_us != history->bucket_us)) {
+        history_close_bucket(history);
+    }
+    history->bucket_us = bucket_us;
+    history->bucket_open = true;
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        if (point.present & history->query.series & (1UL << channel)) {
+            history->sum[channel] += point.values[channel];
+            history->count[channel]++;
+        }
+    }
+}
+
+/* Close the last bucket and the document, false if any of the response was lost */
+bool history_end(history_t *history) {
+    history_close_bucket(history);
+    if (history->query.max_points) {
+        history_lttb_end(history);
+    }
+    if ((history->query.format == HISTORY_JSON) || (history->query.format == HISTORY_CBOR)) {
+        emit_array_end(&history->emit);
+        emit_int(&history->emit, "records", history->records);
+        emit_int(&history->emit, "count", history->points);
+        emit_object_end(&history->emit);
+        return emit_finish(&history->emit);
+    }
+    return chunk_flush(history->chunk);
+}
@@ -0,0 +1,92 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chunk.h"
+#include "emit.h"
+#include "registry.h"
+
+typedef enum {
+    HISTORY_JSON = 0,
+    HISTORY_CSV,
+    HISTORY_BINARY, // per point an int64 timestamp then an int32 milli-unit value per series,
+                    // little endian, with INT32_MIN for a series that had no data
+    HISTORY_CBOR,   // the JSON document encoded as CBOR
+} history_format_t;
+
+#define HISTORY_LTTB_MIN_POINTS 3
+#define HISTORY_LTTB_MAX_POINTS 100000
+
+typedef struct history_query_t {
+    int64_t from_us; // record timestamps, inclusive
+    int64_t to_us;
+    int64_t step_us; // bucket width to average over, zero for every record
+    uint32_t series; // mask of registry channels to return, in channel order
+    uint32_t max_points; // reduce to at most this many points by LTTB, zero for no limit
+    history_format_t format;
+} history_query_t;
+
+typedef struct history_point_t {
+    int64_t timestamp_us;
+    int32_t values[REGISTRY_CHANNEL_COUNT]; // milli-units, indexed by channel
+    uint32_t present;                       // mask of the values that are set
+} history_point_t;
+
+typedef enum {
+    HISTORY_LTTB_FIRST = 0,
+    HISTORY_LTTB_LAST,
+    HISTORY_LTTB_MIN,
+    HISTORY_LTTB_MAX,
+    HISTORY_LTTB_CANDIDATES,
+} history_lttb_candidate_t;
+
+typedef struct history_lttb_bucket_t {
+    int64_t index;
+    int64_t sum_ms; // for the bucket's mean point
+    int64_t sum_milli;
+    uint32_t count;
+    history_point_t candidates[HISTORY_LTTB_CANDIDATES];
+} history_lttb_bucket_t;
+
+typedef struct history_lttb_t {
+    uint8_t channel;                // the series whose shape is kept
+    bool started;
+    int64_t start_us;               // the first point, where the buckets start
+    history_point_t anchor;         // the point last sent
+    history_point_t last;           // the newest point seen
+    history_lttb_bucket_t previous; // waiting for the mean of the current bucket
+    history_lttb_bucket_t current;
+    bool have_previous;
+    bool have_current;
+} history_lttb_t;
+
+typedef struct history_t {
+    history_query_t query;
+    chunk_t *chunk;
+    emit_t emit;
+    int64_t bucket_us; // start of the open bucket
+    bool bucket_open;
+    int64_t sum[REGISTRY_CHANNEL_COUNT];
+    uint32_t count[REGISTRY_CHANNEL_COUNT];
+    uint32_t records; // stream records in range
+    uint32_t points;  // points sent
+    history_lttb_t lttb;
+} history_t;
+
+bool history_series(const char *list, uint32_t *series);
+const char *history_content_type(history_format_t format);
+void history_begin(history_t *history, const history_query_t *query, chunk_t *chunk);
+void history_add(history_t *history, const char *record);
+bool history_end(history_t *history);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* HISTORY_H_ */
@@ -0,0 +1,146 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "json.h"
+
+/*
+ * Streaming JSON writer. Values are written straight to a chunk buffer in document order, with
+ * the separators tracked per nesting level. Every value takes a key, which must be NULL inside
+ * arrays and at the top level. Fixed point values are written without floating point.
+ */
+
+void json_init(json_t *json, chunk_t *chunk) {
+    json->chunk = chunk;
+    json->depth = 0;
+    json->first[0] = true;
+}
+
+static void json_escaped(json_t *json, const char *text) {
+    chunk_write(json->chunk, "\"", 1);
+    const char *run = text;
+    for (const char *c = text; *c; c++) {
+        const char *escape = NULL;
+        char control[8];
+        switch (*c) {
+            case '"':
+                escape = "\\\"";
+                break;
+            case '\\':
+                escape = "\\\\";
+                break;
+            case '\n':
+                escape = "\\n";
+                break;
+            case '\r':
+                escape = "\\r";
+                break;
+            case '\t':
+                escape = "\\t";
+                break;
+            default:
+                if ((unsigned char)*c < 0x20) {
+                    snprintf(control, sizeof(control), "\\u%04x", (unsigned char)*c);
+                    escape = control;
+                }
+                break;
+        }
+        if (escape) {
+            chunk_write(json->chunk, run, c - run);
+            chunk_write(json->chunk, escape, strlen(escape));
+            run = c + 1;
+        }
+    }
+    chunk_write(json->chunk, run, strlen(run));
+    chunk_write(json->chunk, "\"", 1);
+}
+
+/* Separator and key ahead of a value */
+static void json_key(json_t *json, const char *key) {
+    if (!json->first[json->depth]) {
+        chunk_write(json->chunk, ",", 1);
+    }
+    json->first[json->depth] = false;
+    if (key) {
+        json_escaped(json, key);
+        chunk_write(json->chunk, ":", 1);
+    }
+}
+
+static void json_open(json_t *json, const char *key, const char *bracket) {
+    json_key(json, key);
+    chunk_write(json->chunk, bracket, 1);
+    if (json->depth < JSON_DEPTH - 1) {
+        json->first[++json->depth] = true;
+    } else {
+        json->chunk->failed = true;
+    }
+}
+
+static void json_close(json_t *json, const char *bracket) {
+    if (json->depth) {
+        json->depth--;
+    }
+    chunk_write(json->chunk, bracket, 1);
+}
+
+void json_object_begin(json_t *json, const char *key) {
+    json_open(json, key, "{");
+}
+
+void json_object_end(json_t *json) {
+    json_close(json, "}");
+}
+
+void json_array_begin(json_t *json, const char *key) {
+    json_open(json, key, "[");
+}
+
+void json_array_end(json_t *json) {
+    json_close(json, "]");
+}
+
+void json_string(json_t *json, const char *key, const char *value) {
+    json_key(json, key);
+    json_escaped(json, value);
+}
+
+void json_int(json_t *json, const char *key, int64_t value) {
+    json_key(json, key);
+    chunk_printf(json->chunk, "%" PRId64, value);
+}
+
+void json_fixed(json_t *json, const char *key, int64_t value, uint8_t decimals) {
+    json_key(json, key);
+    int64_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    if (decimals == 0) {
+        chunk_printf(json->chunk, "%" PRId64, value);
+    } else {
+        chunk_printf(json->chunk, "%s%" PRIu64 ".%0*" PRIu64, value < 0 ? "-" : "", magnitude / scale,
+                     (int)decimals, magnitude % scale);
+    }
+}
+
+void json_bool(json_t *json, const char *key, bool value) {
+    json_key(json, key);
+    chunk_write(json->chunk, value ? "true" : "false", value ? 4 : 5);
+}
+
+void json_null(json_t *json, const char *key) {
+    json_key(json, key);
+    chunk_write(json->chunk, "null", 4);
+}
+
+/* Send whatever is left in the chunk buffer, false if any part of the document was lost */
+bool json_finish(json_t *json) {
+    if (json->depth) {
+        json->chunk->failed = true;
+    }
+    return chunk_flush(json->chunk);
+}
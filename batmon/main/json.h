@@ -0,0 +1,37 @@
+#ifndef JSON_H
+#define JSON_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chunk.h"
+
+#define JSON_DEPTH 8
+
+typedef struct json_t {
+    chunk_t *chunk;
+    uint8_t depth;
+    bool first[JSON_DEPTH]; // no value written yet at this level
+} json_t;
+
+void json_init(json_t *json, chunk_t *chunk);
+void json_object_begin(json_t *json, const char *key);
+void json_object_end(json_t *json);
+void json_array_begin(json_t *json, const char *key);
+void json_array_end(json_t *json);
+void json_string(json_t *json, const char *key, const char *value);
+void json_int(json_t *json, const char *key, int64_t value);
+void json_fixed(json_t *json, const char *key, int64_t value, uint8_t decimals);
+void json_bool(json_t *json, const char *key, bool value);
+void json_null(json_t *json, const char *key);
+bool json_finish(json_t *json);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* JSON_H_ */
@@ -0,0 +1,103 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "live.h"
+
+/*
+ * Latest telemetry for the live views, published once a period by the acquisition task and
+ * read by any number of HTTP handlers. A sequence lock keeps the two apart without a mutex or
+ * critical section: the writer makes the sequence odd, copies the snapshot in and makes it even
+ * again, and a reader keeps its copy only if it saw the same even sequence before and after.
+ * Readers never block the writer. A reader that keeps colliding with it gives up after
+ * LIVE_READ_RETRIES attempts so the caller can yield, which matters when a higher priority
+ * reader has preempted the writer half way through on the same core.
+ */
+
+typedef struct live_ctx_t {
+    atomic_uint_least32_t lock; // odd while the writer is copying
+    live_snapshot_t snapshot;
+    uint32_t published;
+    int64_t latest_us[REGISTRY_CHANNEL_COUNT];
+} live_ctx_t;
+
+static live_ctx_t live_ctx;
+
+void live_init(void) {
+    memset(&live_ctx.snapshot, 0, sizeof(live_ctx.snapshot));
+    memset(live_ctx.latest_us, 0, sizeof(live_ctx.latest_us));
+    live_ctx.published = 0;
+    atomic_store_explicit(&live_ctx.lock, 0, memory_order_release);
+}
+
+void live_publish(int64_t timestamp_us, const aggregate_result_t results[REGISTRY_CHANNEL_COUNT],
+                  const soc_result_t *soc, const power_result_t *power) {
+    // build outside the lock so the odd window is just the copy
+    live_snapshot_t snapshot = {
+        .sequence = ++live_ctx.published,
+        .timestamp_us = timestamp_us,
+        .power_uw = power->power_uw,
+        .soc = *soc,
+    };
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        const aggregate_result_t *result = &results[channel];
+        live_channel_t *live = &snapshot.channels[channel];
+        if (result->count) {
+            live_ctx.latest_us[channel] = result->latest_us;
+            live->value_milli = result->value_milli;
+            live->min_milli = aggregate_scale(channel, result->min, 1);
+            live->max_milli = aggregate_scale(channel, result->max, 1);
+            live->count = result->count;
+        }
+        live->latest_us = live_ctx.latest_us[channel];
+    }
+
+    uint32_t lock = atomic_load_explicit(&live_ctx.lock, memory_order_relaxed);
+    atomic_store_explicit(&live_ctx.lock, lock + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&live_ctx.snapshot, &snapshot, sizeof(snapshot));
+    atomic_store_explicit(&live_ctx.lock, lock + 2, memory_order_release);
+}
+
+bool live_read(live_snapshot_t *snapshot) {
+    for (int attempt = 0; attempt < LIVE_READ_RETRIES; attempt++) {
+        uint32_t before = atomic_load_explicit(&live_ctx.lock, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(snapshot, &live_ctx.snapshot, sizeof(live_snapshot_t));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&live_ctx.lock, memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Write a snapshot as one object, the same document in either encoding */
+void live_encode(emit_t *emit, const live_snapshot_t *snapshot) {
+    emit_object_begin(emit, NULL);
+    emit_int(emit, "sequence", snapshot->sequence);
+    emit_int(emit, "timestamp_us", snapshot->timestamp_us);
+    emit_object_begin(emit, "channels");
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        const live_channel_t *values = &snapshot->channels[channel];
+        emit_object_begin(emit, registry_entry(channel)->name);
+        emit_string(emit, "units", registry_entry(channel)->units);
+        emit_int(emit, "count", values->count);
+        if (values->count) {
+            emit_fixed(emit, "value", values->value_milli, 3);
+            emit_fixed(emit, "min", values->min_milli, 3);
+            emit_fixed(emit, "max", values->max_milli, 3);
+        }
+        emit_int(emit, "latest_us", values->latest_us);
+        emit_object_end(emit);
+    }
+    emit_object_end(emit);
+    emit_fixed(emit, "power_w", snapshot->power_uw, 6);
+    emit_fixed(emit, "soc", snapshot->soc.soc_permille, 1);
+    emit_bool(emit, "synchronised", snapshot->soc.synchronised);
+    emit_fixed(emit, "remaining_ah", snapshot->soc.remaining_mah, 3);
+    emit_object_end(emit);
+}
@@ -0,0 +1,45 @@
+#ifndef LIVE_H
+#define LIVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "aggregate.h"
+#include "emit.h"
+#include "power.h"
+#include "registry.h"
+#include "soc.h"
+
+#define LIVE_READ_RETRIES 8
+
+typedef struct live_channel_t {
+    int32_t value_milli; // aggregate over the last period
+    int32_t min_milli;
+    int32_t max_milli;
+    uint32_t count;      // frames in the last period, zero if the channel was silent
+    int64_t latest_us;   // newest frame ever seen on the channel
+} live_channel_t;
+
+typedef struct live_snapshot_t {
+    uint32_t sequence;    // snapshots published since boot
+    int64_t timestamp_us; // end of the period
+    live_channel_t channels[REGISTRY_CHANNEL_COUNT];
+    int64_t power_uw;
+    soc_result_t soc;
+} live_snapshot_t;
+
+void live_init(void);
+void live_publish(int64_t timestamp_us, const aggregate_result_t results[REGISTRY_CHANNEL_COUNT],
+                  const soc_result_t *soc, const power_result_t *power);
+bool live_read(live_snapshot_t *snapshot);
+void live_encode(emit_t *emit, const live_snapshot_t *snapshot);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* LIVE_H_ */
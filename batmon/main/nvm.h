@@ -21,6 +21,7 @@ typedef nvm_err_t (*nvm_read)(uint32_t sector_index, uint8_t *sector_buffer);
 typedef nvm_err_t (*nvm_write)(uint32_t sector_index, uint8_t *sector_buffer);
 typedef nvm_err_t (*nvm_erase)(uint32_t sector_index, uint32_t sector_count);
 typedef nvm_err_t (*nvm_close)(void);
+typedef nvm_err_t (*nvm_map)(const uint8_t **base); // read only view of every sector, optional
 
 typedef struct nvm_device_t {
     const nvm_open open;
@@ -28,6 +29,7 @@ typedef struct nvm_device_t {
     const nvm_write write;
     const nvm_erase erase;
     const nvm_close close;
+    const nvm_map map;
     uint32_t sector_size;
     uint32_t sector_count;
     uint32_t erase_count;
@@ -13,48 +13,81 @@
 
 static const char *TAG = "nvm_esp";
 
-static nvm_err_t nvm_esp_open(void);
-static nvm_err_t nvm_esp_read(uint32_t sector_index, uint8_t *sector_buffer);
-static nvm_err_t nvm_esp_write(uint32_t sector_index, uint8_t *sector_buffer);
-static nvm_err_t nvm_esp_erase(uint32_t sector_index, uint32_t sector_count);
-static nvm_err_t nvm_esp_close(void);
+/* One partition of type NVM_PARTITION_TYPE, found by label, behind its own nvm_device_t */
+typedef struct nvm_esp_ctx_t {
+    const char *label;
+    nvm_device_t *device;
+    const esp_partition_t *partition;
+    const void *mapped;
+    esp_partition_mmap_handle_t mmap_handle;
+} nvm_esp_ctx_t;
 
-nvm_device_t nvm_esp = {
-    .open = nvm_esp_open,
-    .read = nvm_esp_read,
-    .write = nvm_esp_write,
-    .erase = nvm_esp_erase,
-    .close = nvm_esp_close,
-    .sector_size = NVM_SECTOR_SIZE,
-    .sector_count = 0,
-    .erase_count = NVM_SECTOR_SIZE,
-    .erased_value = 0xff,
-};
+static nvm_err_t nvm_esp_ctx_open(nvm_esp_ctx_t *ctx);
+static nvm_err_t nvm_esp_ctx_read(nvm_esp_ctx_t *ctx,
+                                  uint32_t sector_index, uint8_t *sector_buffer);
+static nvm_err_t nvm_esp_ctx_write(nvm_esp_ctx_t *ctx,
+                                   uint32_t sector_index, uint8_t *sector_buffer);
+static nvm_err_t nvm_esp_ctx_erase(nvm_esp_ctx_t *ctx,
+                                   uint32_t sector_index, uint32_t sector_count);
+static nvm_err_t nvm_esp_ctx_map(nvm_esp_ctx_t *ctx, const uint8_t **base);
+static nvm_err_t nvm_esp_close(void) { return NVM_OK; }
+
+/* The device interface takes no context, so each partition gets its own small wrappers */
+#define NVM_ESP_DEVICE(name, partition_label)                                                  \
+    nvm_device_t name;                                                                         \
+    static nvm_esp_ctx_t name##_ctx = {.label = partition_label, .device = &name};             \
+    static nvm_err_t name##_open(void) { return nvm_esp_ctx_open(&name##_ctx); }               \
+    static nvm_err_t name##_read(uint32_t sector_index, uint8_t *sector_buffer) {              \
+        return nvm_esp_ctx_read(&name##_ctx, sector_index, sector_buffer);                     \
+    }                                                                                          \
+    static nvm_err_t name##_write(uint32_t sector_index, uint8_t *sector_buffer) {             \
+        return nvm_esp_ctx_write(&name##_ctx, sector_index, sector_buffer);                    \
+    }                                                                                          \
+    static nvm_err_t name##_erase(uint32_t sector_index, uint32_t sector_count) {              \
+        return nvm_esp_ctx_erase(&name##_ctx, sector_index, sector_count);                     \
+    }                                                                                          \
+    static nvm_err_t name##_map(const uint8_t **base) {                                        \
+        return nvm_esp_ctx_map(&name##_ctx, base);                                             \
+    }                                                                                          \
+    nvm_device_t name = {                                                                      \
+        .open = name##_open,                                                                   \
+        .read = name##_read,                                                                   \
+        .write = name##_write,                                                                 \
+        .erase = name##_erase,                                                                 \
+        .close = nvm_esp_close,                                                                \
+        .map = name##_map,                                                                     \
+        .sector_size = NVM_SECTOR_SIZE,                                                        \
+        .sector_count = 0,                                                                     \
+        .erase_count = NVM_SECTOR_SIZE,                                                        \
+        .erased_value = 0xff,                                                                  \
+    };
 
-static const esp_partition_t *nvm_esp_partition = NULL;
+NVM_ESP_DEVICE(nvm_esp, "storage")
+NVM_ESP_DEVICE(nvm_esp_cycles, "cycles")
 
-static nvm_err_t nvm_esp_open(void) {
-    nvm_esp_partition =
-        esp_partition_find_first(NVM_PARTITION_TYPE, NVM_PARTITION_SUB_TYPE, "storage");
-    if (nvm_esp_partition == NULL) {
-        ESP_LOGE(TAG, "nvm partition not found!");
+static nvm_err_t nvm_esp_ctx_open(nvm_esp_ctx_t *ctx) {
+    ctx->partition =
+        esp_partition_find_first(NVM_PARTITION_TYPE, NVM_PARTITION_SUB_TYPE, ctx->label);
+    if (ctx->partition == NULL) {
+        ESP_LOGE(TAG, "nvm partition '%s' not found!", ctx->label);
         return NVM_FAIL;
     } else {
         ESP_LOGI(TAG,
                  "found nvm partition '%s' at offset 0x%" PRIx32 " with size 0x%" PRIx32
                  " with sector size 0x%x",
-                 nvm_esp_partition->label, nvm_esp_partition->address, nvm_esp_partition->size,
+                 ctx->partition->label, ctx->partition->address, ctx->partition->size,
                  NVM_SECTOR_SIZE);
     }
-    nvm_esp.sector_count = nvm_esp_partition->size / NVM_SECTOR_SIZE;
-    nvm_esp.erase_count = nvm_esp_partition->erase_size / NVM_SECTOR_SIZE;
+    ctx->device->sector_count = ctx->partition->size / NVM_SECTOR_SIZE;
+    ctx->device->erase_count = ctx->partition->erase_size / NVM_SECTOR_SIZE;
     return NVM_OK;
 }
 
-static nvm_err_t nvm_esp_read(uint32_t sector_index, uint8_t *sector_buffer) {
-    esp_err_t err = esp_partition_read_raw(nvm_esp_partition, sector_index * NVM_SECTOR_SIZE,
+static nvm_err_t nvm_esp_ctx_read(nvm_esp_ctx_t *ctx,
+                                  uint32_t sector_index, uint8_t *sector_buffer) {
+    esp_err_t err = esp_partition_read_raw(ctx->partition, sector_index * NVM_SECTOR_SIZE,
                                            sector_buffer, 512);
-    // esp_err_t err = esp_partition_read_raw(nvm_esp_partition, sector_index * NVM_SECTOR_SIZE,
+    // esp_err_t err = esp_partition_read_raw(ctx->partition, sector_index * NVM_SECTOR_SIZE,
     //                                        sector_buffer, NVM_SECTOR_SIZE);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "read block %" PRIx32 " failed!", sector_index);
@@ -65,8 +98,9 @@ static nvm_err_t nvm_esp_read(uint32_t sector_index, uint8_t *sector_buffer) {
     return NVM_OK;
 }
 
-static nvm_err_t nvm_esp_write(uint32_t sector_index, uint8_t *sector_buffer) {
-    esp_err_t err = esp_partition_write_raw(nvm_esp_partition, sector_index * NVM_SECTOR_SIZE,
+static nvm_err_t nvm_esp_ctx_write(nvm_esp_ctx_t *ctx,
+                                   uint32_t sector_index, uint8_t *sector_buffer) {
+    esp_err_t err = esp_partition_write_raw(ctx->partition, sector_index * NVM_SECTOR_SIZE,
                                             sector_buffer, NVM_SECTOR_SIZE);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "write block %" PRIx32 " failed!", sector_index);
@@ -77,8 +111,9 @@ static nvm_err_t nvm_esp_write(uint32_t sector_index, uint8_t *sector_buffer) {
     return NVM_OK;
 }
 
-static nvm_err_t nvm_esp_erase(uint32_t sector_index, uint32_t sector_count) {
-    esp_err_t err = esp_partition_erase_range(nvm_esp_partition, sector_index * NVM_SECTOR_SIZE,
+static nvm_err_t nvm_esp_ctx_erase(nvm_esp_ctx_t *ctx,
+                                   uint32_t sector_index, uint32_t sector_count) {
+    esp_err_t err = esp_partition_erase_range(ctx->partition, sector_index * NVM_SECTOR_SIZE,
                                               sector_count * NVM_SECTOR_SIZE);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "erase %" PRIx32 " blocks from block %" PRIx32 " failed with error %d",
@@ -91,4 +126,18 @@ static nvm_err_t nvm_esp_erase(uint32_t sector_index, uint32_t sector_count) {
     return NVM_OK;
 }
 
-static nvm_err_t nvm_esp_close(void) { return NVM_OK; }
+/* Map the whole partition into the data address space once, and keep it mapped */
+static nvm_err_t nvm_esp_ctx_map(nvm_esp_ctx_t *ctx, const uint8_t **base) {
+    if (ctx->mapped == NULL) {
+        esp_err_t err = esp_partition_mmap(ctx->partition, 0, ctx->partition->size,
+                                           ESP_PARTITION_MMAP_DATA, &ctx->mapped,
+                                           &ctx->mmap_handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "map partition failed with error %d", err);
+            ctx->mapped = NULL;
+            return NVM_FAIL;
+        }
+    }
+    *base = ctx->mapped;
+    return NVM_OK;
+}
@@ -9,7 +9,8 @@ extern "C" {
 
 #define NVM_SECTOR_SIZE (4096)
 
-extern nvm_device_t nvm_esp;
+extern nvm_device_t nvm_esp;        // the "storage" partition, one record per second
+extern nvm_device_t nvm_esp_cycles; // the "cycles" partition, one record per charge or discharge
 
 #ifdef __cplusplus
 } // extern "C"
@@ -13,6 +13,7 @@ static nvm_err_t nvm_file_read(uint32_t sector_index, uint8_t *sector_buffer);
 static nvm_err_t nvm_file_write(uint32_t sector_index, uint8_t *sector_buffer);
 static nvm_err_t nvm_file_erase(uint32_t sector_index, uint32_t sector_count);
 static nvm_err_t nvm_file_close(void);
+static nvm_err_t nvm_file_map(const uint8_t **base);
 
 nvm_device_t nvm_file = {
     .open = nvm_file_open,
@@ -20,6 +21,7 @@ nvm_device_t nvm_file = {
     .write = nvm_file_write,
     .erase = nvm_file_erase,
     .close = nvm_file_close,
+    .map = nvm_file_map,
     .sector_size = NVM_SECTOR_SIZE,
     .sector_count = NVM_FILE_SECTOR_COUNT,
     .erase_count = NVM_SECTOR_SIZE,
@@ -104,3 +106,8 @@ static nvm_err_t nvm_file_close(void) {
     }
     return NVM_OK;
 }
+
+static nvm_err_t nvm_file_map(const uint8_t **base) {
+    *base = nvm_file_data;
+    return NVM_OK;
+}
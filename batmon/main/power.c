@@ -0,0 +1,171 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "aggregate.h"
+#include "power.h"
+#include "registry.h"
+
+/*
+ * Instantaneous power from the separate current and voltage streams. Frames are stamped in
+ * arrival order, so a current frame can only be paired once the next voltage frame is in: it
+ * waits in a small FIFO and is then paired with the voltage interpolated linearly between the
+ * voltage frames either side of it. If the FIFO fills or a frame waits longer than
+ * POWER_MAX_LAG_US it is paired with the last voltage instead, so pairing never stalls.
+ * The power samples are integrated into energy with the same exact trapezoidal counters as the
+ * coulomb counter.
+ */
+
+#define POWER_PENDING_SIZE 8
+#define POWER_MAX_LAG_US 500000
+#define POWER_MAX_GAP_US (10 * 1000000LL) // longer gaps between power samples are not integrated
+#define POWER_UWH_DOUBLED (2LL * 3600LL * 1000000LL) // twice the uW.us in one uWh
+
+typedef struct power_sample_t {
+    int64_t timestamp_us;
+    int32_t value; // milli-units
+} power_sample_t;
+
+typedef struct power_counter_t {
+    int64_t units;
+    int64_t residue;
+} power_counter_t;
+
+typedef struct power_ctx_t {
+    power_sample_t pending[POWER_PENDING_SIZE]; // current frames waiting for a voltage frame
+    uint8_t pending_head;
+    uint8_t pending_size;
+    power_sample_t voltage; // latest voltage frame
+    bool have_voltage;
+    int64_t last_power_uw;
+    int64_t last_timestamp_us;
+    bool have_power;
+    int64_t power_sum_uw;
+    power_counter_t energy_in;
+    power_counter_t energy_out;
+    power_result_t result;
+} power_ctx_t;
+
+static power_ctx_t power_ctx;
+
+static void power_accumulate(power_counter_t *counter, int64_t increment) {
+    counter->residue += increment;
+    if (counter->residue >= POWER_UWH_DOUBLED) {
+        int64_t units = counter->residue / POWER_UWH_DOUBLED;
+        counter->units += units;
+        counter->residue -= units * POWER_UWH_DOUBLED;
+    }
+}
+
+static void power_emit(power_ctx_t *ctx, const power_sample_t *current, int32_t voltage_mv,
+                       bool held) {
+    int64_t power_uw = (int64_t)current->value * voltage_mv;
+    int64_t dt_us = current->timestamp_us - ctx->last_timestamp_us;
+    if (ctx->have_power && (dt_us > 0) && (dt_us <= POWER_MAX_GAP_US)) {
+        int64_t energy = (ctx->last_power_uw + power_uw) * dt_us;
+        if (energy >= 0) {
+            power_accumulate(&ctx->energy_in, energy);
+        } else {
+            power_accumulate(&ctx->energy_out, -energy);
+        }
+    }
+    ctx->last_power_uw = power_uw;
+    ctx->last_timestamp_us = current->timestamp_us;
+    ctx->have_power = true;
+    ctx->power_sum_uw += power_uw;
+    ctx->result.timestamp_us = current->timestamp_us;
+    ctx->result.power_uw = power_uw;
+    ctx->result.samples++;
+    ctx->result.held += held;
+}
+
+static power_sample_t *power_pending_front(power_ctx_t *ctx) {
+    return &ctx->pending[ctx->pending_head];
+}
+
+static void power_pending_pop(power_ctx_t *ctx) {
+    ctx->pending_head = (ctx->pending_head + 1) % POWER_PENDING_SIZE;
+    ctx->pending_size--;
+}
+
+/* Pair the frames that have waited too long with the held voltage */
+static void power_release(power_ctx_t *ctx, int64_t now_us) {
+    while ((ctx->pending_size > 0) &&
+           (now_us - power_pending_front(ctx)->timestamp_us > POWER_MAX_LAG_US)) {
+        if (ctx->have_voltage) {
+            power_emit(ctx, power_pending_front(ctx), ctx->voltage.value, true);
+        }
+        power_pending_pop(ctx);
+    }
+}
+
+void power_init(void) { memset(&power_ctx, 0, sizeof(power_ctx)); }
+
+void power_add(uint8_t device_id, int16_t value, int64_t timestamp_us) {
+    power_ctx_t *ctx = &power_ctx;
+    uint8_t channel = registry_channel(device_id);
+    if (channel == REGISTRY_CHANNEL_CURRENT) {
+        if (ctx->pending_size == POWER_PENDING_SIZE) {
+            if (ctx->have_voltage) {
+                power_emit(ctx, power_pending_front(ctx), ctx->voltage.value, true);
+            }
+            power_pending_pop(ctx);
+        }
+        power_sample_t *sample =
+            &ctx->pending[(ctx->pending_head + ctx->pending_size) % POWER_PENDING_SIZE];
+        sample->timestamp_us = timestamp_us;
+        sample->value = aggregate_scale(channel, value, 1);
+        ctx->pending_size++;
+    } else if (channel == REGISTRY_CHANNEL_VOLTAGE) {
+        power_sample_t voltage = {.timestamp_us = timestamp_us,
+                                  .value = aggregate_scale(channel, value, 1)};
+        while (ctx->pending_size > 0) {
+            const power_sample_t *current = power_pending_front(ctx);
+            if (current->timestamp_us > voltage.timestamp_us) {
+                break;
+            }
+            int32_t voltage_mv = voltage.value;
+            bool held = !ctx->have_voltage;
+            int64_t span_us = voltage.timestamp_us - ctx->voltage.timestamp_us;
+            if (ctx->have_voltage && (span_us > 0) &&
+                (current->timestamp_us >= ctx->voltage.timestamp_us)) {
+                voltage_mv = ctx->voltage.value +
+                             ((int64_t)(voltage.value - ctx->voltage.value) *
+                              (current->timestamp_us - ctx->voltage.timestamp_us)) /
+                                 span_us;
+            }
+            power_emit(ctx, current, voltage_mv, held);
+            power_pending_pop(ctx);
+        }
+        ctx->voltage = voltage;
+        ctx->have_voltage = true;
+    } else {
+        return;
+    }
+    power_release(ctx, timestamp_us);
+}
+
+void power_get(power_result_t *result) {
+    const power_ctx_t *ctx = &power_ctx;
+    *result = ctx->result;
+    result->mean_power_uw = ctx->result.samples > 0 ? ctx->power_sum_uw / ctx->result.samples : 0;
+    result->energy_in_uwh = ctx->energy_in.units;
+    result->energy_out_uwh = ctx->energy_out.units;
+}
+
+/* Report and restart the mean power, call once per reporting period */
+void power_flush(power_result_t *result) {
+    power_get(result);
+    power_ctx.power_sum_uw = 0;
+    power_ctx.result.samples = 0;
+    power_ctx.result.held = 0;
+}
+
+/* Serialise as "P,timestamp_us,mean_power_uw,samples,held,energy_in_uwh,energy_out_uwh" */
+int power_serialise(char *buffer, size_t size, const power_result_t *result) {
+    return snprintf(buffer, size, POWER_RECORD_TAG ",%lld,%lld,%lu,%lu,%lld,%lld",
+                    (long long)result->timestamp_us, (long long)result->mean_power_uw,
+                    (unsigned long)result->samples, (unsigned long)result->held,
+                    (long long)result->energy_in_uwh, (long long)result->energy_out_uwh);
+}
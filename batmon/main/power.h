@@ -0,0 +1,33 @@
+#ifndef POWER_H
+#define POWER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define POWER_RECORD_TAG "P"
+
+typedef struct power_result_t {
+    int64_t timestamp_us;  // current frame of the latest power sample
+    int64_t power_uw;      // latest power sample
+    int64_t mean_power_uw; // mean of the samples since the last power_flush()
+    uint32_t samples;      // samples since the last power_flush()
+    uint32_t held;         // of which were paired with a held rather than interpolated voltage
+    int64_t energy_in_uwh; // totals since boot
+    int64_t energy_out_uwh;
+} power_result_t;
+
+void power_init(void);
+void power_add(uint8_t device_id, int16_t value, int64_t timestamp_us);
+void power_get(power_result_t *result);
+void power_flush(power_result_t *result);
+int power_serialise(char *buffer, size_t size, const power_result_t *result);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* POWER_H_ */
@@ -0,0 +1,331 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/select.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "aggregate.h"
+#include "bus.h"
+#include "chunk.h"
+#include "push.h"
+#include "spsc.h"
+
+/*
+ * Live telemetry pushed to WebSocket clients. A task of its own takes the aggregates and raw
+ * frames from the bus, so the acquisition task never waits on the network. Each message is
+ * encoded at most once per format into a shared frame, and the frame is handed to every client
+ * that wants it through that client's queue of frame indices, with a reference count so the
+ * frame is reused once the last client has sent it. Sending runs on the HTTP server task as
+ * queued work, and must not block it: a frame is only sent once select() says the socket can
+ * take it, which lwIP reports only with far more send buffer free than a frame needs. A client
+ * without room keeps its queue until the next message, and is closed after PUSH_STALL_US.
+ *
+ * Every client chooses its own interval, applied per topic and channel like the bus rate
+ * limit. A client whose queue is full, or that the frame pool has run out for, misses the
+ * message and it is counted, so a slow client costs the others nothing and memory is fixed.
+ * A client is closed by the server task and the slot is freed by the push task once no send is
+ * queued, which keeps each queue to one producer and one consumer.
+ */
+
+static const char *TAG = "push";
+
+#define PUSH_STALL_US (5 * 1000000LL) // a client that cannot take a frame this long is closed
+
+typedef enum {
+    PUSH_CLIENT_FREE = 0,
+    PUSH_CLIENT_OPENING, // being filled in by the server task
+    PUSH_CLIENT_OPEN,
+    PUSH_CLIENT_CLOSING, // no more sends, waiting for the push task to free it
+} push_client_state_t;
+
+typedef struct push_frame_t {
+    atomic_uint_least32_t references; // queued sends, plus one while being handed out
+    uint16_t size;
+    uint8_t data[PUSH_FRAME_SIZE];
+} push_frame_t;
+
+typedef struct push_client_t {
+    atomic_uint_least32_t state;
+    atomic_bool queued; // a drain is queued on the server task
+    httpd_handle_t server;
+    int fd;
+    emit_format_t format;
+    atomic_uint_least32_t interval_ms;
+    atomic_bool frames;
+    int64_t next_us[BUS_TOPIC_COUNT][REGISTRY_CHANNEL_COUNT]; // push task only
+    spsc_t queue;                                             // frame indices
+    uint8_t queue_storage[PUSH_CLIENT_QUEUE];
+    int64_t stalled_us; // server task only, when the socket last had no room, zero if it has
+    uint32_t sent;
+    uint32_t limited;
+    uint32_t dropped;
+} push_client_t;
+
+typedef struct push_ctx_t {
+    bus_subscriber_t *subscriber;
+    push_client_t clients[PUSH_CLIENT_COUNT];
+    push_frame_t frames[PUSH_FRAME_COUNT];
+} push_ctx_t;
+
+static push_ctx_t push_ctx;
+
+BUS_STORAGE_DEFINE(push_bus_storage, PUSH_BUS_QUEUE);
+
+/* Chunk sender that keeps the encoding in the frame, a second send means it did not fit */
+static bool push_frame_accept(void *context, const char *data, size_t size) {
+    push_frame_t *frame = context;
+    if (frame->size) {
+        return false;
+    }
+    frame->size = size;
+    return true;
+}
+
+/* Encode a message into a free frame held once for the caller, -1 if none is free or it is too long */
+static int push_encode(const bus_message_t *message, emit_format_t format) {
+    int index = 0;
+    while ((index < PUSH_FRAME_COUNT) &&
+           atomic_load_explicit(&push_ctx.frames[index].references, memory_order_acquire)) {
+        index++;
+    }
+    if (index == PUSH_FRAME_COUNT) {
+        return -1;
+    }
+    push_frame_t *frame = &push_ctx.frames[index];
+    const registry_entry_t *entry = registry_entry(message->channel);
+    chunk_t chunk;
+    emit_t emit;
+    frame->size = 0;
+    chunk_init(&chunk, (char *)frame->data, sizeof(frame->data), push_frame_accept, frame);
+    emit_init(&emit, format, &chunk);
+    emit_object_begin(&emit, NULL);
+    emit_string(&emit, "topic", message->topic == BUS_TOPIC_FRAME ? "frame" : "aggregate");
+    emit_int(&emit, "timestamp_us", message->timestamp_us);
+    emit_string(&emit, "channel", entry->name);
+    emit_string(&emit, "units", entry->units);
+    if (message->topic == BUS_TOPIC_FRAME) {
+        emit_fixed(&emit, "value", aggregate_scale(message->channel, message->value, 1), 3);
+    } else {
+        const aggregate_result_t *aggregate = &message->aggregate;
+        emit_int(&emit, "count", aggregate->count);
+        if (aggregate->count) {
+            emit_fixed(&emit, "value", aggregate->value_milli, 3);
+            emit_fixed(&emit, "min", aggregate_scale(message->channel, aggregate->min, 1), 3);
+            emit_fixed(&emit, "max", aggregate_scale(message->channel, aggregate->max, 1), 3);
+        }
+    }
+    emit_object_end(&emit);
+    if (!emit_finish(&emit)) {
+        return -1;
+    }
+    atomic_store_explicit(&frame->references, 1, memory_order_relaxed);
+    return index;
+}
+
+static void push_client_close(push_client_t *client) {
+    uint_least32_t state = PUSH_CLIENT_OPEN;
+    atomic_compare_exchange_strong(&client->state, &state, PUSH_CLIENT_CLOSING);
+}
+
+/* True if the socket has room for a frame now, so sending it cannot block the server task */
+static bool push_writable(int fd) {
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(fd, &writable);
+    struct timeval timeout = {0};
+    return select(fd + 1, NULL, &writable, NULL, &timeout) == 1;
+}
+
+/* Server task: send everything queued for a client, in order, while its socket has room */
+static void push_drain(void *arg) {
+    push_client_t *client = arg;
+    bool stalled = false;
+    do {
+        uint8_t *index;
+        while (!stalled &&
+               (atomic_load_explicit(&client->state, memory_order_acquire) == PUSH_CLIENT_OPEN) &&
+               spsc_peek(&client->queue, (void **)&index, 1)) {
+            push_frame_t *frame = &push_ctx.frames[*index];
+            httpd_ws_frame_t ws_frame = {
+                .final = true,
+                .type = client->format == EMIT_CBOR ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT,
+                .payload = frame->data,
+                .len = frame->size,
+            };
+            if (httpd_ws_get_fd_info(client->server, client->fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+                push_client_close(client);
+            } else if (!push_writable(client->fd)) {
+                int64_t now_us = esp_timer_get_time();
+                if (client->stalled_us == 0) {
+                    client->stalled_us = now_us;
+                }
+                if (now_us - client->stalled_us < PUSH_STALL_US) {
+                    stalled = true; // keep the queue, the next message tries again
+                    continue;
+                }
+                ESP_LOGW(TAG, "Client %d stalled, closing", client->fd);
+                push_client_close(client);
+                httpd_sess_trigger_close(client->server, client->fd);
+            } else if (httpd_ws_send_frame_async(client->server, client->fd, &ws_frame) != ESP_OK) {
+                push_client_close(client);
+                httpd_sess_trigger_close(client->server, client->fd);
+            } else {
+                client->stalled_us = 0;
+                client->sent++;
+            }
+            atomic_fetch_sub_explicit(&frame->references, 1, memory_order_release);
+            spsc_release(&client->queue, 1);
+        }
+        atomic_store_explicit(&client->queued, false, memory_order_release);
+        // anything queued after the last peek would otherwise wait for the next message
+    } while (!stalled &&
+             (atomic_load_explicit(&client->state, memory_order_acquire) == PUSH_CLIENT_OPEN) &&
+             spsc_used(&client->queue) && !atomic_exchange(&client->queued, true));
+}
+
+static void push_schedule(push_client_t *client) {
+    if (!atomic_exchange(&client->queued, true) &&
+        (httpd_queue_work(client->server, push_drain, client) != ESP_OK)) {
+        atomic_store_explicit(&client->queued, false, memory_order_release);
+    }
+}
+
+/* Hand one message to every client that wants it now, encoding it once per format */
+static void push_message(const bus_message_t *message) {
+    int frames[] = {[EMIT_JSON] = -1, [EMIT_CBOR] = -1};
+    for (int i = 0; i < PUSH_CLIENT_COUNT; i++) {
+        push_client_t *client = &push_ctx.clients[i];
+        if (atomic_load_explicit(&client->state, memory_order_acquire) != PUSH_CLIENT_OPEN) {
+            continue;
+        }
+        if ((message->topic == BUS_TOPIC_FRAME) && !atomic_load(&client->frames)) {
+            continue;
+        }
+        int64_t interval_us = atomic_load(&client->interval_ms) * 1000LL;
+        int64_t *next_us = &client->next_us[message->topic][message->channel];
+        if (interval_us && (message->timestamp_us < *next_us)) {
+            client->limited++;
+            continue;
+        }
+        *next_us = message->timestamp_us + interval_us;
+        if (frames[client->format] < 0) {
+            frames[client->format] = push_encode(message, client->format);
+        }
+        uint8_t index = frames[client->format];
+        if ((frames[client->format] < 0) || !spsc_push(&client->queue, &index)) {
+            client->dropped++;
+            continue;
+        }
+        atomic_fetch_add_explicit(&push_ctx.frames[index].references, 1, memory_order_relaxed);
+        push_schedule(client);
+    }
+    for (int format = EMIT_JSON; format <= EMIT_CBOR; format++) {
+        if (frames[format] >= 0) {
+            atomic_fetch_sub_explicit(&push_ctx.frames[frames[format]].references, 1,
+                                      memory_order_release);
+        }
+    }
+}
+
+/* Free the slots of closed clients once the server task has let go of them */
+static void push_reap(void) {
+    for (int i = 0; i < PUSH_CLIENT_COUNT; i++) {
+        push_client_t *client = &push_ctx.clients[i];
+        if ((atomic_load_explicit(&client->state, memory_order_acquire) != PUSH_CLIENT_CLOSING) ||
+            atomic_load_explicit(&client->queued, memory_order_acquire)) {
+            continue;
+        }
+        uint8_t index;
+        while (spsc_pop(&client->queue, &index)) {
+            atomic_fetch_sub_explicit(&push_ctx.frames[index].references, 1, memory_order_release);
+        }
+        ESP_LOGI(TAG, "Client %d closed, %lu sent, %lu limited, %lu dropped", client->fd,
+                 (unsigned long)client->sent, (unsigned long)client->limited,
+                 (unsigned long)client->dropped);
+        atomic_store_explicit(&client->state, PUSH_CLIENT_FREE, memory_order_release);
+    }
+}
+
+static void push_task(void *arg) {
+    while (1) {
+        bus_message_t message;
+        while (bus_receive(push_ctx.subscriber, &message)) {
+            push_message(&message);
+        }
+        push_reap();
+        vTaskDelay(pdMS_TO_TICKS(PUSH_TASK_PERIOD_MS));
+    }
+}
+
+/* Call after bus_init() */
+void push_init(void) {
+    memset(&push_ctx, 0, sizeof(push_ctx));
+    push_ctx.subscriber =
+        bus_subscribe("push", BUS_TOPIC_MASK(BUS_TOPIC_FRAME) | BUS_TOPIC_MASK(BUS_TOPIC_AGGREGATE),
+                      0, push_bus_storage, PUSH_BUS_QUEUE);
+    if (push_ctx.subscriber == NULL) {
+        ESP_LOGE(TAG, "No bus subscriber left");
+        return;
+    }
+    xTaskCreate(push_task, "push", PUSH_TASK_STACK, NULL, PUSH_TASK_PRIO, NULL);
+}
+
+/* Server task: start pushing to a WebSocket that has just connected, false if all slots are taken */
+bool push_client_add(httpd_handle_t server, int fd, const push_options_t *options) {
+    if (push_ctx.subscriber == NULL) {
+        return false;
+    }
+    push_client_remove(fd); // a socket number reused before its last client was noticed closing
+    for (int i = 0; i < PUSH_CLIENT_COUNT; i++) {
+        push_client_t *client = &push_ctx.clients[i];
+        uint_least32_t state = PUSH_CLIENT_FREE;
+        if (!atomic_compare_exchange_strong(&client->state, &state, PUSH_CLIENT_OPENING)) {
+            continue;
+        }
+        client->server = server;
+        client->fd = fd;
+        client->format = options->format;
+        atomic_store(&client->interval_ms, options->interval_ms);
+        atomic_store(&client->frames, options->frames);
+        atomic_store(&client->queued, false);
+        memset(client->next_us, 0, sizeof(client->next_us));
+        spsc_init(&client->queue, client->queue_storage, sizeof(uint8_t), PUSH_CLIENT_QUEUE);
+        client->stalled_us = 0;
+        client->sent = 0;
+        client->limited = 0;
+        client->dropped = 0;
+        atomic_store_explicit(&client->state, PUSH_CLIENT_OPEN, memory_order_release);
+        ESP_LOGI(TAG, "Client %d open, every %lu ms%s", fd, (unsigned long)options->interval_ms,
+                 options->frames ? " with frames" : "");
+        return true;
+    }
+    return false;
+}
+
+/* Server task: change the rate and topics of an open client, the format is fixed at connect */
+bool push_client_configure(int fd, const push_options_t *options) {
+    for (int i = 0; i < PUSH_CLIENT_COUNT; i++) {
+        push_client_t *client = &push_ctx.clients[i];
+        if ((atomic_load_explicit(&client->state, memory_order_acquire) == PUSH_CLIENT_OPEN) &&
+            (client->fd == fd)) {
+            atomic_store(&client->interval_ms, options->interval_ms);
+            atomic_store(&client->frames, options->frames);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Server task: stop pushing to a client, its slot is freed later by the push task */
+void push_client_remove(int fd) {
+    for (int i = 0; i < PUSH_CLIENT_COUNT; i++) {
+        if (push_ctx.clients[i].fd == fd) {
+            push_client_close(&push_ctx.clients[i]);
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef PUSH_H
+#define PUSH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "emit.h"
+#include "esp_http_server.h"
+
+#define PUSH_CLIENT_COUNT 4
+#define PUSH_CLIENT_QUEUE 8 // frames waiting per client, a power of two
+#define PUSH_FRAME_SIZE 192
+#define PUSH_FRAME_COUNT (PUSH_CLIENT_COUNT * PUSH_CLIENT_QUEUE + 2)
+#define PUSH_BUS_QUEUE 64
+#define PUSH_TASK_PERIOD_MS 10
+#define PUSH_TASK_PRIO 4
+#define PUSH_TASK_STACK 4096
+
+typedef struct push_options_t {
+    uint32_t interval_ms; // minimum spacing per channel, 0 for every message
+    bool frames;          // raw tinbus frames as well as the aggregates
+    emit_format_t format; // JSON as text messages, CBOR as binary
+} push_options_t;
+
+void push_init(void);
+bool push_client_add(httpd_handle_t server, int fd, const push_options_t *options);
+bool push_client_configure(int fd, const push_options_t *options);
+void push_client_remove(int fd);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* PUSH_H_ */
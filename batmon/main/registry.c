@@ -0,0 +1,35 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "registry.h"
+
+// one row per channel, in registry_channel_t order
+static const registry_entry_t registry_entries[REGISTRY_CHANNEL_COUNT] = {
+    [REGISTRY_CHANNEL_CURRENT] = {.device_id = 1,
+                                  .name = "current",
+                                  .units = "A",
+                                  .scale_num = 1,
+                                  .scale_den = 1,
+                                  .aggregate = REGISTRY_AGGREGATE_MEAN,
+                                  .stream = REGISTRY_STREAM_BATTERY},
+    [REGISTRY_CHANNEL_VOLTAGE] = {.device_id = 2,
+                                  .name = "voltage",
+                                  .units = "V",
+                                  .scale_num = 1,
+                                  .scale_den = 1,
+                                  .aggregate = REGISTRY_AGGREGATE_MEAN,
+                                  .stream = REGISTRY_STREAM_BATTERY},
+};
+
+static uint8_t registry_index[REGISTRY_DEVICE_COUNT];
+
+void registry_init(void) {
+    memset(registry_index, REGISTRY_NO_CHANNEL, sizeof(registry_index));
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        registry_index[registry_entries[channel].device_id] = channel;
+    }
+}
+
+uint8_t registry_channel(uint8_t device_id) { return registry_index[device_id]; }
+
+const registry_entry_t *registry_entry(uint8_t channel) { return &registry_entries[channel]; }
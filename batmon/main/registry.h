@@ -0,0 +1,50 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define REGISTRY_DEVICE_COUNT 256 // tinbus device ids are a single byte
+#define REGISTRY_NO_CHANNEL 0xFF
+
+// channels are numbered densely so per channel state can live in small arrays
+typedef enum {
+    REGISTRY_CHANNEL_CURRENT = 0,
+    REGISTRY_CHANNEL_VOLTAGE,
+    REGISTRY_CHANNEL_COUNT,
+} registry_channel_t;
+
+typedef enum {
+    REGISTRY_STREAM_BATTERY = 0,
+    REGISTRY_STREAM_COUNT,
+} registry_stream_t;
+
+typedef enum {
+    REGISTRY_AGGREGATE_MEAN = 0,
+    REGISTRY_AGGREGATE_MIN,
+    REGISTRY_AGGREGATE_MAX,
+    REGISTRY_AGGREGATE_LAST,
+} registry_aggregate_t;
+
+typedef struct registry_entry_t {
+    uint8_t device_id;
+    const char *name;
+    const char *units;
+    int32_t scale_num; // milli-units per raw count is scale_num / scale_den
+    int32_t scale_den;
+    registry_aggregate_t aggregate;
+    registry_stream_t stream;
+} registry_entry_t;
+
+void registry_init(void);
+uint8_t registry_channel(uint8_t device_id);
+const registry_entry_t *registry_entry(uint8_t channel);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* REGISTRY_H_ */
@@ -0,0 +1,98 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aggregate.h"
+#include "registry.h"
+#include "resistance.h"
+
+/*
+ * Internal resistance from load steps. Each voltage frame is paired with the latest current
+ * frame. When the current of consecutive pairs differs by at least RESISTANCE_MIN_STEP_MA, and
+ * the pairs are close enough in time that the open circuit voltage cannot have moved, the step
+ * gives one observation dv = r * di. The observations are combined by scalar recursive least
+ * squares with exponential forgetting so the estimate follows slow ageing of the battery.
+ */
+
+#define RESISTANCE_MIN_STEP_MA 5000
+#define RESISTANCE_MAX_PAIR_GAP_US 500000
+#define RESISTANCE_FORGETTING 0.98f
+#define RESISTANCE_INITIAL_UOHM 10000.0f
+#define RESISTANCE_INITIAL_P 1.0f
+
+typedef struct resistance_ctx_t {
+    int32_t current_ma;
+    bool have_current;
+    int32_t pair_current_ma; // previous current / voltage pair
+    int32_t pair_voltage_mv;
+    int64_t pair_timestamp_us;
+    bool have_pair;
+    float estimate_ohm; // recursive least squares state
+    float p;
+    resistance_result_t result;
+} resistance_ctx_t;
+
+static resistance_ctx_t resistance_ctx;
+
+void resistance_init(void) {
+    memset(&resistance_ctx, 0, sizeof(resistance_ctx));
+    resistance_ctx.estimate_ohm = RESISTANCE_INITIAL_UOHM * 1e-6f;
+    resistance_ctx.p = RESISTANCE_INITIAL_P;
+    resistance_ctx.result.estimate_uohm = RESISTANCE_INITIAL_UOHM;
+}
+
+/* Returns true when the frame completed a load step and a new estimate is available */
+bool resistance_add(uint8_t device_id, int16_t value, int64_t timestamp_us) {
+    resistance_ctx_t *ctx = &resistance_ctx;
+    uint8_t channel = registry_channel(device_id);
+    if (channel == REGISTRY_CHANNEL_CURRENT) {
+        ctx->current_ma = aggregate_scale(channel, value, 1);
+        ctx->have_current = true;
+        return false;
+    }
+    if ((channel != REGISTRY_CHANNEL_VOLTAGE) || !ctx->have_current) {
+        return false;
+    }
+    int32_t voltage_mv = aggregate_scale(channel, value, 1);
+    int32_t delta_ma = ctx->current_ma - ctx->pair_current_ma;
+    int32_t delta_mv = voltage_mv - ctx->pair_voltage_mv;
+    bool step = ctx->have_pair &&
+                (timestamp_us - ctx->pair_timestamp_us <= RESISTANCE_MAX_PAIR_GAP_US) &&
+                (abs(delta_ma) >= RESISTANCE_MIN_STEP_MA);
+
+    ctx->pair_current_ma = ctx->current_ma;
+    ctx->pair_voltage_mv = voltage_mv;
+    ctx->pair_timestamp_us = timestamp_us;
+    ctx->have_pair = true;
+    if (!step) {
+        return false;
+    }
+
+    float x = delta_ma * 0.001f;
+    float y = delta_mv * 0.001f;
+    float gain = ctx->p * x / (RESISTANCE_FORGETTING + x * ctx->p * x);
+    ctx->estimate_ohm += gain * (y - x * ctx->estimate_ohm);
+    ctx->p = (ctx->p - gain * x * ctx->p) / RESISTANCE_FORGETTING;
+
+    resistance_result_t *result = &ctx->result;
+    result->timestamp_us = timestamp_us;
+    result->delta_mv = delta_mv;
+    result->delta_ma = delta_ma;
+    result->step_uohm = ((int64_t)delta_mv * 1000000) / delta_ma;
+    result->estimate_uohm = lrintf(ctx->estimate_ohm * 1e6f);
+    result->steps++;
+    return true;
+}
+
+void resistance_get(resistance_result_t *result) { *result = resistance_ctx.result; }
+
+/* Serialise as "R,timestamp_us,delta_mv,delta_ma,step_uohm,estimate_uohm" for the storage ring */
+int resistance_serialise(char *buffer, size_t size, const resistance_result_t *result) {
+    return snprintf(buffer, size, RESISTANCE_RECORD_TAG ",%lld,%ld,%ld,%ld,%ld",
+                    (long long)result->timestamp_us, (long)result->delta_mv,
+                    (long)result->delta_ma, (long)result->step_uohm,
+                    (long)result->estimate_uohm);
+}
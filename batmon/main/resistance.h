@@ -0,0 +1,32 @@
+#ifndef RESISTANCE_H
+#define RESISTANCE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESISTANCE_RECORD_TAG "R"
+
+typedef struct resistance_result_t {
+    int64_t timestamp_us; // voltage frame that completed the last step
+    int32_t delta_mv;     // voltage and current change across the last step
+    int32_t delta_ma;
+    int32_t step_uohm;     // delta_mv / delta_ma for the last step alone
+    int32_t estimate_uohm; // recursive least squares estimate over all steps
+    uint32_t steps;
+} resistance_result_t;
+
+void resistance_init(void);
+bool resistance_add(uint8_t device_id, int16_t value, int64_t timestamp_us);
+void resistance_get(resistance_result_t *result);
+int resistance_serialise(char *buffer, size_t size, const resistance_result_t *result);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* RESISTANCE_H_ */
@@ -6,12 +6,14 @@
    software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
    CONDITIONS OF ANY KIND, either express or implied.
 */
-#include "cJSON.h"
 #include "esp_chip_info.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_random.h"
+#include "esp_timer.h"
 #include "esp_vfs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <fcntl.h>
 #include <string.h>
 
@@ -20,6 +22,20 @@
 #include <sys/unistd.h>
 
 #include "batmon_littlefs.h"
+#include "burst.h"
+#include "chunk.h"
+#include "cycle.h"
+#include "ekf.h"
+#include "emit.h"
+#include "history.h"
+#include "live.h"
+#include "push.h"
+#include "registry.h"
+#include "rest_server.h"
+#include "rules.h"
+#include "soc.h"
+#include "spectrum.h"
+#include "www.h"
 
 static const char *TAG = "rest_server";
 
@@ -33,45 +49,165 @@ static const char *REST_TAG = "esp-rest";
     } while (0)
 
 #define FILE_PATH_MAX (ESP_VFS_PATH_MAX + 128)
+#define LIVE_READ_ATTEMPTS 4 // each after yielding a tick to let the writer finish
 #define SCRATCH_BUFSIZE (10240)
+#define REST_CHUNK_SIZE 512 // streamed responses never hold more than this in memory
+#define REST_QUERY_SIZE 128
+#define REST_MAX_URI_HANDLERS 24 // the httpd default of 8 is too few for the API
+#define REST_RECORDS_LIMIT 100
+#define REST_RECORDS_MAX 1000
+#define REST_PUSH_INTERVAL_MS 1000
 
 typedef struct rest_server_context {
     char base_path[ESP_VFS_PATH_MAX + 1];
     char scratch[SCRATCH_BUFSIZE];
 } rest_server_context_t;
 
-#define CHECK_FILE_EXTENSION(filename, ext) (strcasecmp(&filename[strlen(filename) - strlen(ext)], ext) == 0)
+static soc_result_t rest_soc;
+static ekf_result_t rest_ekf;
+static bool rest_ekf_valid = false;
+static portMUX_TYPE rest_soc_lock = portMUX_INITIALIZER_UNLOCKED;
 
-/* Set HTTP response content type according to file extension */
-static esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filepath) {
-    const char *type = "text/plain";
-    if (CHECK_FILE_EXTENSION(filepath, ".html")) {
-        type = "text/html";
-    } else if (CHECK_FILE_EXTENSION(filepath, ".js")) {
-        type = "application/javascript";
-    } else if (CHECK_FILE_EXTENSION(filepath, ".css")) {
-        type = "text/css";
-    } else if (CHECK_FILE_EXTENSION(filepath, ".png")) {
-        type = "image/png";
-    } else if (CHECK_FILE_EXTENSION(filepath, ".ico")) {
-        type = "image/x-icon";
-    } else if (CHECK_FILE_EXTENSION(filepath, ".svg")) {
-        type = "text/xml";
+static spectrum_result_t rest_spectrum;
+static portMUX_TYPE rest_spectrum_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static storage_handle_t rest_storage = NULL;
+static storage_handle_t rest_cycle_storage = NULL; // completed phases, one record each
+static uint32_t rest_boot_nonce; // tells exports from different boots apart
+
+static rules_stats_t rest_rules;
+static portMUX_TYPE rest_rules_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static window_stats_t rest_windows[REGISTRY_CHANNEL_COUNT][WINDOW_COUNT];
+static int64_t rest_windows_us;
+static portMUX_TYPE rest_windows_lock = portMUX_INITIALIZER_UNLOCKED;
+
+typedef struct rest_content_type_t {
+    const char *extension;
+    const char *type;
+    const char *cache_control;
+} rest_content_type_t;
+
+#define REST_CACHE_REVALIDATE "no-cache" // pages are checked every time, a 304 costs no body
+#define REST_CACHE_ASSET "public, max-age=3600"
+#define REST_ETAG_SIZE 32
+
+static const rest_content_type_t rest_content_types[] = {
+    {".html", "text/html", REST_CACHE_REVALIDATE},
+    {".js", "application/javascript", REST_CACHE_ASSET},
+    {".css", "text/css", REST_CACHE_ASSET},
+    {".json", "application/json", REST_CACHE_REVALIDATE},
+    {".png", "image/png", REST_CACHE_ASSET},
+    {".ico", "image/x-icon", REST_CACHE_ASSET},
+    {".svg", "image/svg+xml", REST_CACHE_ASSET},
+};
+
+static const rest_content_type_t rest_content_type_default = {"", "text/plain", REST_CACHE_REVALIDATE};
+
+/* Look up the content type and caching of a file by its extension */
+static const rest_content_type_t *rest_content_type(const char *filepath) {
+    const char *extension = strrchr(filepath, '.');
+    if (extension) {
+        for (int i = 0; i < sizeof(rest_content_types) / sizeof(rest_content_types[0]); i++) {
+            if (strcasecmp(extension, rest_content_types[i].extension) == 0) {
+                return &rest_content_types[i];
+            }
+        }
+    }
+    return &rest_content_type_default;
+}
+
+/* True if a request header contains the text, a truncated header is searched as far as it goes */
+static bool rest_header_contains(httpd_req_t *req, const char *field, const char *text) {
+    char value[REST_QUERY_SIZE];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, field, value, sizeof(value));
+    return ((err == ESP_OK) || (err == ESP_ERR_HTTPD_RESULT_TRUNC)) && strstr(value, text);
+}
+
+/* Set the validation headers, true if the client already has this version and a 304 was sent */
+static bool rest_not_modified(httpd_req_t *req, const char *etag, const rest_content_type_t *content_type) {
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", content_type->cache_control);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    if (!rest_header_contains(req, "If-None-Match", etag)) {
+        return false;
     }
-    return httpd_resp_set_type(req, type);
+    httpd_resp_set_status(req, "304 Not Modified");
+    httpd_resp_send(req, NULL, 0);
+    return true;
 }
 
-/* Send HTTP response with the contents of the requested file */
+/*
+ * Send an asset built into the image in one piece, straight from the mapped flash. A client that
+ * does not take gzip gets the uncompressed copy of a page; other assets are held only gzipped
+ * and are sent that way regardless, as the browsers that load them all take gzip.
+ */
+static esp_err_t rest_send_asset(httpd_req_t *req, const www_asset_t *asset,
+                                 const rest_content_type_t *content_type, bool accepts_gzip) {
+    bool identity = !accepts_gzip && asset->identity_start;
+    if (rest_not_modified(req, identity ? asset->identity_etag : asset->etag, content_type)) {
+        return ESP_OK;
+    }
+    httpd_resp_set_type(req, content_type->type);
+    if (identity) {
+        return httpd_resp_send(req, (const char *)asset->identity_start,
+                               asset->identity_end - asset->identity_start);
+    }
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)asset->start, asset->end - asset->start);
+}
+
+/*
+ * Send a static file. The web UI built into the image is looked up first, and always answers
+ * for its own paths whether or not the client takes gzip. Other files come from the filesystem,
+ * the pre-compressed .gz beside it when the client takes gzip. Its ETag is made from the size
+ * and modification time so it needs only a stat, and a matching If-None-Match is answered with
+ * 304 without opening the file.
+ */
 static esp_err_t rest_common_get_handler(httpd_req_t *req) {
     char filepath[FILE_PATH_MAX];
+    struct stat file_stat;
 
     rest_server_context_t *rest_context = (rest_server_context_t *)req->user_ctx;
-    strlcpy(filepath, rest_context->base_path, sizeof(filepath));
-    if (req->uri[strlen(req->uri) - 1] == '/') {
-        strlcat(filepath, "/index.html", sizeof(filepath));
-    } else {
-        strlcat(filepath, req->uri, sizeof(filepath));
+    size_t base_length = strlcpy(filepath, rest_context->base_path, sizeof(filepath));
+    strlcat(filepath, req->uri, sizeof(filepath));
+    char *query = strchr(&filepath[base_length], '?');
+    if (query) {
+        *query = '\0';
+    }
+    if (filepath[strlen(filepath) - 1] == '/') {
+        strlcpy(&filepath[base_length], "/index.html", sizeof(filepath) - base_length);
+    }
+    const rest_content_type_t *content_type = rest_content_type(filepath);
+    bool accepts_gzip = rest_header_contains(req, "Accept-Encoding", "gzip");
+
+    const www_asset_t *asset = www_find(&filepath[base_length]);
+    if (asset) {
+        return rest_send_asset(req, asset, content_type, accepts_gzip);
     }
+
+    size_t length = strlen(filepath);
+    bool gzip = false;
+    if (accepts_gzip && (length + 3 < sizeof(filepath))) {
+        strlcat(filepath, ".gz", sizeof(filepath));
+        gzip = stat(filepath, &file_stat) == 0;
+        if (!gzip) {
+            filepath[length] = '\0';
+        }
+    }
+    if (!gzip && (stat(filepath, &file_stat) == -1)) {
+        ESP_LOGE(REST_TAG, "Failed to stat file : %s", filepath);
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File does not exist");
+        return ESP_FAIL;
+    }
+
+    char etag[REST_ETAG_SIZE];
+    snprintf(etag, sizeof(etag), "\"%lx-%llx%s\"", (unsigned long)file_stat.st_size,
+             (unsigned long long)file_stat.st_mtime, gzip ? "-gz" : "");
+    if (rest_not_modified(req, etag, content_type)) {
+        return ESP_OK;
+    }
+
     int fd = open(filepath, O_RDONLY, 0);
     if (fd == -1) {
         ESP_LOGE(REST_TAG, "Failed to open file : %s", filepath);
@@ -79,8 +215,10 @@ static esp_err_t rest_common_get_handler(httpd_req_t *req) {
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read existing file");
         return ESP_FAIL;
     }
-
-    set_content_type_from_file(req, filepath);
+    httpd_resp_set_type(req, content_type->type);
+    if (gzip) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
 
     char *chunk = rest_context->scratch;
     ssize_t read_bytes;
@@ -110,6 +248,30 @@ static esp_err_t rest_common_get_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+static bool rest_send_chunk(void *context, const char *data, size_t size) {
+    return httpd_resp_send_chunk((httpd_req_t *)context, data, size) == ESP_OK;
+}
+
+/* Terminate a streamed response, or drop the connection if part of it was lost */
+static esp_err_t rest_finish_chunks(httpd_req_t *req, bool sent) {
+    if (!sent) {
+        ESP_LOGE(REST_TAG, "Streamed response to %s failed", req->uri);
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+/* Pick the response encoding from the Accept header, JSON unless CBOR is asked for */
+static emit_format_t rest_accept_format(httpd_req_t *req) {
+    char accept[REST_QUERY_SIZE];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "Accept", accept, sizeof(accept));
+    if (((err == ESP_OK) || (err == ESP_ERR_HTTPD_RESULT_TRUNC)) &&
+        strstr(accept, emit_content_type(EMIT_CBOR))) {
+        return EMIT_CBOR;
+    }
+    return EMIT_JSON;
+}
+
 /* Simple handler for light brightness control */
 // static esp_err_t light_brightness_post_handler(httpd_req_t *req)
 // {
@@ -145,17 +307,21 @@ static esp_err_t rest_common_get_handler(httpd_req_t *req) {
 
 /* Simple handler for getting system handler */
 static esp_err_t system_info_get_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "application/json");
-    cJSON *root = cJSON_CreateObject();
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    emit_t emit;
     esp_chip_info_t chip_info;
     esp_chip_info(&chip_info);
-    cJSON_AddStringToObject(root, "version", IDF_VER);
-    cJSON_AddNumberToObject(root, "cores", chip_info.cores);
-    const char *sys_info = cJSON_Print(root);
-    httpd_resp_sendstr(req, sys_info);
-    free((void *)sys_info);
-    cJSON_Delete(root);
-    return ESP_OK;
+
+    emit_format_t format = rest_accept_format(req);
+    httpd_resp_set_type(req, emit_content_type(format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    emit_init(&emit, format, &chunk);
+    emit_object_begin(&emit, NULL);
+    emit_string(&emit, "version", IDF_VER);
+    emit_int(&emit, "cores", chip_info.cores);
+    emit_object_end(&emit);
+    return rest_finish_chunks(req, emit_finish(&emit));
 }
 
 /* Simple handler for getting system handler */
@@ -181,13 +347,18 @@ static esp_err_t directory_get_handler(httpd_req_t *req) {
         return ESP_FAIL;
     }
 
-    httpd_resp_set_type(req, "application/json");
-    cJSON *root = cJSON_CreateObject();
-    cJSON *array = cJSON_CreateArray();
-    cJSON_AddItemToObject(root, "littlefs", array);
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    emit_t emit;
+    emit_format_t format = rest_accept_format(req);
+    httpd_resp_set_type(req, emit_content_type(format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    emit_init(&emit, format, &chunk);
+    emit_object_begin(&emit, NULL);
+    emit_array_begin(&emit, "littlefs");
 
     /* Iterate over all files / folders and fetch their names and sizes */
-    while ((entry = readdir(dir)) != NULL) {
+    while (((entry = readdir(dir)) != NULL) && !chunk.failed) {
         entrytype = (entry->d_type == DT_DIR ? "directory" : "file");
 
         strlcpy(entrypath + dirpath_len, entry->d_name, sizeof(entrypath) - dirpath_len);
@@ -198,33 +369,652 @@ static esp_err_t directory_get_handler(httpd_req_t *req) {
         }
         ESP_LOGI(TAG, "Found %s : %s (%ld bytes)", entrytype, entrypath, entry_stat.st_size); // entry->d_name, entry_stat.st_size);
 
-        cJSON *file = cJSON_CreateObject();
-        cJSON_AddStringToObject(file, "name", entry->d_name);
-        cJSON_AddStringToObject(file, "type", entrytype);
-        cJSON_AddNumberToObject(file, "size", entry_stat.st_size);
-        cJSON_AddItemToArray(array, file);
+        emit_object_begin(&emit, NULL);
+        emit_string(&emit, "name", entry->d_name);
+        emit_string(&emit, "type", entrytype);
+        emit_int(&emit, "size", entry_stat.st_size);
+        emit_object_end(&emit);
     }
     closedir(dir);
 
-    const char *dir_info = cJSON_Print(root);
-    httpd_resp_sendstr(req, dir_info);
-    free((void *)dir_info);
-    cJSON_Delete(root);
-    return ESP_OK;
+    emit_array_end(&emit);
+    emit_object_end(&emit);
+    return rest_finish_chunks(req, emit_finish(&emit));
 }
 
 /* Simple handler for getting temperature data */
 static esp_err_t temperature_data_get_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "application/json");
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "raw", esp_random() % 20);
-    const char *sys_info = cJSON_Print(root);
-    httpd_resp_sendstr(req, sys_info);
-    free((void *)sys_info);
-    cJSON_Delete(root);
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    emit_t emit;
+    emit_format_t format = rest_accept_format(req);
+    httpd_resp_set_type(req, emit_content_type(format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    emit_init(&emit, format, &chunk);
+    emit_object_begin(&emit, NULL);
+    emit_int(&emit, "raw", esp_random() % 20);
+    emit_object_end(&emit);
+    return rest_finish_chunks(req, emit_finish(&emit));
+}
+
+/* Handler for getting the latest aggregates and state of charge without touching the sampling path */
+static esp_err_t live_get_handler(httpd_req_t *req) {
+    live_snapshot_t live;
+    bool valid = false;
+    for (int attempt = 0; !valid && (attempt < LIVE_READ_ATTEMPTS); attempt++) {
+        valid = live_read(&live);
+        if (!valid) {
+            vTaskDelay(1);
+        }
+    }
+    if (!valid || (live.sequence == 0)) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "No live data");
+        return ESP_OK;
+    }
+
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    emit_t emit;
+    emit_format_t format = rest_accept_format(req);
+    httpd_resp_set_type(req, emit_content_type(format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    emit_init(&emit, format, &chunk);
+    live_encode(&emit, &live);
+    return rest_finish_chunks(req, emit_finish(&emit));
+}
+
+/* Read a whole number of seconds from the query string as microseconds */
+static bool rest_query_seconds(const char *query, const char *key, int64_t *value_us) {
+    char value[24];
+    if (httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return true; // absent, keep the default
+    }
+    char *end;
+    long long seconds = strtoll(value, &end, 10);
+    if ((end == value) || (*end != '\0') || (seconds < 0) || (seconds > INT64_MAX / 1000000)) {
+        return false;
+    }
+    *value_us = seconds * 1000000;
+    return true;
+}
+
+/* Read a whole number from the query string */
+static bool rest_query_count(const char *query, const char *key, uint32_t *count) {
+    char value[12];
+    if (httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return true; // absent, keep the default
+    }
+    char *end;
+    unsigned long number = strtoul(value, &end, 10);
+    if ((end == value) || (*end != '\0') || (number > UINT32_MAX)) {
+        return false;
+    }
+    *count = number;
+    return true;
+}
+
+/* Read push options from a query string, or a text message in the same form */
+static bool rest_push_options(const char *text, push_options_t *options) {
+    char value[8];
+    if (!rest_query_count(text, "interval_ms", &options->interval_ms)) {
+        return false;
+    }
+    if (httpd_query_key_value(text, "frames", value, sizeof(value)) == ESP_OK) {
+        options->frames = strcmp(value, "1") == 0;
+    }
+    if (httpd_query_key_value(text, "format", value, sizeof(value)) == ESP_OK) {
+        options->format = strcmp(value, "cbor") == 0 ? EMIT_CBOR : EMIT_JSON;
+    }
+    return true;
+}
+
+/* WebSocket pushing aggregates, and raw frames if asked, options in the query and in later text messages */
+static esp_err_t stream_ws_handler(httpd_req_t *req) {
+    push_options_t options = {
+        .interval_ms = REST_PUSH_INTERVAL_MS,
+        .frames = false,
+        .format = EMIT_JSON,
+    };
+    char text[REST_QUERY_SIZE];
+    int fd = httpd_req_to_sockfd(req);
+    if (req->method == HTTP_GET) { // handshake done, the socket is now a WebSocket
+        if ((httpd_req_get_url_query_str(req, text, sizeof(text)) == ESP_OK) &&
+            !rest_push_options(text, &options)) {
+            return ESP_FAIL;
+        }
+        if (!push_client_add(req->handle, fd, &options)) {
+            ESP_LOGW(REST_TAG, "No push slot for socket %d", fd);
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+    httpd_ws_frame_t frame = {.type = HTTPD_WS_TYPE_TEXT};
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0); // just the length
+    if ((err != ESP_OK) || (frame.len >= sizeof(text))) {
+        push_client_remove(fd);
+        return ESP_FAIL;
+    }
+    frame.payload = (uint8_t *)text;
+    err = httpd_ws_recv_frame(req, &frame, sizeof(text) - 1);
+    if (err != ESP_OK) {
+        push_client_remove(fd);
+        return err;
+    }
+    text[frame.len] = '\0';
+    // each message restates the options, the format stays as it was at connect
+    if ((frame.type == HTTPD_WS_TYPE_TEXT) && rest_push_options(text, &options)) {
+        push_client_configure(fd, &options);
+    }
     return ESP_OK;
 }
 
+/*
+ * Handler for streaming logged stream records between two times, downsampled to a step. Times
+ * count from boot, so only records written since this boot are read; older ones would land in
+ * the same range and mix with them.
+ */
+static esp_err_t history_get_handler(httpd_req_t *req) {
+    history_query_t query = {
+        .from_us = 0,
+        .to_us = INT64_MAX,
+        .step_us = 0,
+        .series = (1UL << REGISTRY_CHANNEL_COUNT) - 1,
+        .max_points = 0,
+        .format = HISTORY_JSON,
+    };
+    char text[REST_QUERY_SIZE];
+    if (httpd_req_get_url_query_str(req, text, sizeof(text)) == ESP_OK) {
+        char series[REST_QUERY_SIZE];
+        if (!rest_query_seconds(text, "from", &query.from_us) ||
+            !rest_query_seconds(text, "to", &query.to_us) ||
+            !rest_query_seconds(text, "step", &query.step_us) ||
+            !rest_query_count(text, "max_points", &query.max_points) ||
+            ((httpd_query_key_value(text, "series", series, sizeof(series)) == ESP_OK) &&
+             !history_series(series, &query.series))) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad history query");
+            return ESP_FAIL;
+        }
+    } else if (httpd_req_get_url_query_len(req) >= sizeof(text)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "History query too long");
+        return ESP_FAIL;
+    }
+    // nothing is logged in the future, and LTTB spreads its buckets up to to_us
+    int64_t now_us = esp_timer_get_time();
+    query.to_us = query.to_us < now_us ? query.to_us : now_us;
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "Accept", text, sizeof(text));
+    if ((err == ESP_OK) || (err == ESP_ERR_HTTPD_RESULT_TRUNC)) {
+        if (strstr(text, "text/csv")) {
+            query.format = HISTORY_CSV;
+        } else if (strstr(text, "application/octet-stream")) {
+            query.format = HISTORY_BINARY;
+        } else if (strstr(text, emit_content_type(EMIT_CBOR))) {
+            query.format = HISTORY_CBOR;
+        }
+    }
+
+    storage_cursor_t cursor;
+    if ((rest_storage == NULL) || (storage_cursor_open(rest_storage, &cursor) != NVM_OK)) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Storage busy");
+        return ESP_OK;
+    }
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    history_t history;
+    const char *record;
+    httpd_resp_set_type(req, history_content_type(query.format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    // when the boot's first block has been overwritten the cursor starts at the oldest, which
+    // is later still
+    storage_cursor_seek(cursor, storage_boot_sequence(rest_storage));
+    history_begin(&history, &query, &chunk);
+    while (!chunk.failed && (storage_cursor_next(cursor, &record) == NVM_OK)) {
+        history_add(&history, record);
+    }
+    storage_cursor_close(cursor);
+    bool sent = history_end(&history);
+    ESP_LOGI(REST_TAG, "History sent %lu points from %lu records", (unsigned long)history.points,
+             (unsigned long)history.records);
+    return rest_finish_chunks(req, sent);
+}
+
+/*
+ * Handler for incremental sync, the records logged since a sequence number and the next one to
+ * ask for. Sequence numbers keep rising across reboots; timestamps restart at each boot, so the
+ * response also gives the sequence number the current boot started at.
+ */
+static esp_err_t records_get_handler(httpd_req_t *req) {
+    uint64_t since = 0;
+    uint32_t limit = REST_RECORDS_LIMIT;
+    char text[REST_QUERY_SIZE];
+    if (httpd_req_get_url_query_str(req, text, sizeof(text)) == ESP_OK) {
+        char value[24];
+        if (httpd_query_key_value(text, "since", value, sizeof(value)) == ESP_OK) {
+            char *end;
+            since = strtoull(value, &end, 10);
+            if ((end == value) || (*end != '\0')) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad since");
+                return ESP_FAIL;
+            }
+        }
+        if (!rest_query_count(text, "limit", &limit)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad limit");
+            return ESP_FAIL;
+        }
+    }
+    limit = limit < REST_RECORDS_MAX ? limit : REST_RECORDS_MAX;
+
+    storage_cursor_t cursor;
+    if ((rest_storage == NULL) || (storage_cursor_open(rest_storage, &cursor) != NVM_OK)) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Storage busy");
+        return ESP_OK;
+    }
+    bool lost = storage_cursor_seek(cursor, since) != NVM_OK;
+    uint64_t from = lost ? 0 : since; // after a loss send everything that is left
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    emit_t emit;
+    emit_format_t format = rest_accept_format(req);
+    httpd_resp_set_type(req, emit_content_type(format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    emit_init(&emit, format, &chunk);
+    emit_object_begin(&emit, NULL);
+    emit_int(&emit, "since", since);
+    emit_int(&emit, "boot", storage_boot_sequence(rest_storage));
+    emit_array_begin(&emit, "records");
+    uint64_t next = since;
+    uint32_t count = 0;
+    const char *record;
+    while ((count < limit) && !chunk.failed && (storage_cursor_next(cursor, &record) == NVM_OK)) {
+        uint64_t sequence = storage_cursor_sequence(cursor);
+        if ((sequence < from) || (*record == '\0')) {
+            continue; // earlier in the block that holds since
+        }
+        emit_object_begin(&emit, NULL);
+        emit_int(&emit, "seq", sequence);
+        emit_string(&emit, "record", record);
+        emit_object_end(&emit);
+        next = sequence + 1;
+        count++;
+    }
+    storage_cursor_close(cursor);
+    emit_array_end(&emit);
+    emit_int(&emit, "next", next);
+    emit_bool(&emit, "lost", lost); // records after since were overwritten, or the ring formatted
+    emit_object_end(&emit);
+    return rest_finish_chunks(req, emit_finish(&emit));
+}
+
+/* Parse a single "bytes=first-last" range against the total size, false if it cannot be served */
+static bool rest_parse_range(const char *range, size_t total, size_t *first, size_t *last) {
+    char *end;
+    if ((strncmp(range, "bytes=", 6) != 0) || (total == 0)) {
+        return false;
+    }
+    range += 6;
+    if (*range == '-') { // the final bytes
+        unsigned long suffix = strtoul(range + 1, &end, 10);
+        if ((end == range + 1) || (*end != '\0') || (suffix == 0)) {
+            return false;
+        }
+        *first = suffix < total ? total - suffix : 0;
+        *last = total - 1;
+        return true;
+    }
+    *first = strtoul(range, &end, 10);
+    if ((end == range) || (*end != '-')) {
+        return false;
+    }
+    range = end + 1;
+    *last = total - 1;
+    if (*range != '\0') {
+        unsigned long to = strtoul(range, &end, 10);
+        if (*end != '\0') {
+            return false;
+        }
+        *last = to < total ? to : total - 1;
+    }
+    return (*first <= *last) && (*first < total);
+}
+
+/*
+ * Handler for downloading the blocks of the storage ring, raw and in write order. The size and
+ * ETag come from the cursor's snapshot of the logger, so the body is exactly the blocks that
+ * were written when the request arrived, in one pass. Each block is copied and checked before
+ * it is sent, and one lost in the meantime goes out zeroed to keep the offsets. The write
+ * counter starts again at every boot, so the ETag carries a per-boot nonce as well.
+ */
+static esp_err_t export_raw_get_handler(httpd_req_t *req) {
+    storage_cursor_t cursor;
+    const uint8_t *block;
+    if ((rest_storage == NULL) || (storage_cursor_open(rest_storage, &cursor) != NVM_OK)) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Storage busy");
+        return ESP_OK;
+    }
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08lx-%08lx\"", (unsigned long)rest_boot_nonce,
+             (unsigned long)storage_cursor_head(cursor));
+    size_t block_size = storage_block_size();
+    size_t total = storage_cursor_blocks(cursor) * block_size;
+
+    size_t first = 0;
+    size_t last = total ? total - 1 : 0;
+    char range[48];
+    char content_range[48];
+    bool partial = false;
+    if (httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK) {
+        // a resume against a ring that has moved on gets the whole of the new one
+        char if_range[24];
+        if ((httpd_req_get_hdr_value_str(req, "If-Range", if_range, sizeof(if_range)) != ESP_OK) ||
+            (strcmp(if_range, etag) == 0)) {
+            if (!rest_parse_range(range, total, &first, &last)) {
+                storage_cursor_close(cursor);
+                snprintf(content_range, sizeof(content_range), "bytes */%u", (unsigned)total);
+                httpd_resp_set_status(req, "416 Range Not Satisfiable");
+                httpd_resp_set_hdr(req, "Content-Range", content_range);
+                httpd_resp_send(req, NULL, 0);
+                return ESP_OK;
+            }
+            partial = true;
+        }
+    }
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+    if (partial) {
+        snprintf(content_range, sizeof(content_range), "bytes %u-%u/%u", (unsigned)first,
+                 (unsigned)last, (unsigned)total);
+        httpd_resp_set_status(req, "206 Partial Content");
+        httpd_resp_set_hdr(req, "Content-Range", content_range);
+    }
+
+    bool sent = true;
+    size_t offset = 0;
+    while (total && sent && (offset <= last) &&
+           (storage_cursor_block(cursor, &block) != NVM_EMPTY)) {
+        if (offset + block_size > first) {
+            size_t start = first > offset ? first - offset : 0;
+            size_t end = last + 1 < offset + block_size ? last + 1 - offset : block_size;
+            sent = httpd_resp_send_chunk(req, (const char *)&block[start], end - start) == ESP_OK;
+        }
+        offset += block_size;
+    }
+    storage_cursor_close(cursor);
+    return rest_finish_chunks(req, sent);
+}
+
+/* Handler for getting the coulomb counter state */
+static esp_err_t soc_get_handler(httpd_req_t *req) {
+    soc_result_t soc;
+    ekf_result_t ekf;
+    bool ekf_valid;
+    portENTER_CRITICAL(&rest_soc_lock);
+    soc = rest_soc;
+    ekf = rest_ekf;
+    ekf_valid = rest_ekf_valid;
+    portEXIT_CRITICAL(&rest_soc_lock);
+
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    emit_t emit;
+    emit_format_t format = rest_accept_format(req);
+    httpd_resp_set_type(req, emit_content_type(format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    emit_init(&emit, format, &chunk);
+    emit_object_begin(&emit, NULL);
+    emit_int(&emit, "timestamp_us", soc.timestamp_us);
+    emit_fixed(&emit, "soc", soc.soc_permille, 1);
+    emit_bool(&emit, "synchronised", soc.synchronised);
+    emit_fixed(&emit, "remaining_ah", soc.remaining_mah, 3);
+    emit_fixed(&emit, "charge_in_ah", soc.charge_in_uah, 6);
+    emit_fixed(&emit, "charge_out_ah", soc.charge_out_uah, 6);
+    emit_fixed(&emit, "energy_in_wh", soc.energy_in_uwh, 6);
+    emit_fixed(&emit, "energy_out_wh", soc.energy_out_uwh, 6);
+    if (ekf_valid) {
+        emit_fixed(&emit, "ekf_soc", ekf.soc_permille, 1);
+        emit_fixed(&emit, "ekf_soc_stddev", ekf.soc_stddev_permille, 1);
+    }
+    emit_object_end(&emit);
+    return rest_finish_chunks(req, emit_finish(&emit));
+}
+
+/* Handler for getting the ripple spectrum of the latest burst capture */
+static esp_err_t spectrum_get_handler(httpd_req_t *req) {
+    spectrum_result_t spectrum;
+    portENTER_CRITICAL(&rest_spectrum_lock);
+    spectrum = rest_spectrum;
+    portEXIT_CRITICAL(&rest_spectrum_lock);
+
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    emit_t emit;
+    emit_format_t format = rest_accept_format(req);
+    httpd_resp_set_type(req, emit_content_type(format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    emit_init(&emit, format, &chunk);
+    emit_object_begin(&emit, NULL);
+    emit_int(&emit, "timestamp_us", spectrum.timestamp_us);
+    emit_string(&emit, "channel", registry_entry(spectrum.channel)->name);
+    emit_int(&emit, "points", spectrum.points);
+    emit_fixed(&emit, "sample_rate_hz", spectrum.sample_rate_mhz, 3);
+    emit_array_begin(&emit, "peaks");
+    for (int i = 0; i < spectrum.peak_count; i++) {
+        emit_object_begin(&emit, NULL);
+        emit_fixed(&emit, "frequency_hz", spectrum.peaks[i].frequency_mhz, 3);
+        emit_fixed(&emit, "amplitude", spectrum.peaks[i].amplitude_milli, 3);
+        emit_object_end(&emit);
+    }
+    emit_array_end(&emit);
+    emit_object_end(&emit);
+    return rest_finish_chunks(req, emit_finish(&emit));
+}
+
+/* Handler for getting the relay rule states and decision latency */
+static esp_err_t relays_get_handler(httpd_req_t *req) {
+    rules_stats_t rules;
+    portENTER_CRITICAL(&rest_rules_lock);
+    rules = rest_rules;
+    portEXIT_CRITICAL(&rest_rules_lock);
+
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    emit_t emit;
+    emit_format_t format = rest_accept_format(req);
+    httpd_resp_set_type(req, emit_content_type(format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    emit_init(&emit, format, &chunk);
+    emit_object_begin(&emit, NULL);
+    emit_int(&emit, "changes", rules.changes);
+    emit_int(&emit, "last_latency_us", rules.last_latency_us);
+    emit_int(&emit, "max_latency_us", rules.max_latency_us);
+    emit_array_begin(&emit, "rules");
+    for (uint8_t i = 0; i < rules_count(); i++) {
+        const rules_rule_t *rule = rules_rule(i);
+        emit_object_begin(&emit, NULL);
+        emit_string(&emit, "channel", registry_entry(rule->channel)->name);
+        if (rule->source != RULES_LATEST) {
+            static const char *const sources[] = {
+                [RULES_MEAN] = "mean", [RULES_MIN] = "min", [RULES_MAX] = "max"};
+            emit_string(&emit, "source", sources[rule->source]);
+            emit_int(&emit, "window_s", window_seconds(rule->window));
+        }
+        emit_string(&emit, "compare", rule->compare == RULES_BELOW ? "below" : "above");
+        emit_fixed(&emit, "threshold", rule->threshold_milli, 3);
+        emit_int(&emit, "gpio", rule->relay);
+        emit_bool(&emit, "active", (rules.active_mask >> i) & 1);
+        emit_object_end(&emit);
+    }
+    emit_array_end(&emit);
+    emit_object_end(&emit);
+    return rest_finish_chunks(req, emit_finish(&emit));
+}
+
+/*
+ * Handler for listing the completed charge and discharge phases kept in the cycle ring, oldest
+ * first. The ring survives resets, so a range is given in Unix seconds from..to and matched
+ * against each phase's wall-clock stamp; phases that ended before the clock was set are only
+ * listed when no range is asked for.
+ */
+static esp_err_t cycles_get_handler(httpd_req_t *req) {
+    int64_t from_us = INT64_MIN;
+    int64_t to_us = INT64_MAX;
+    char text[REST_QUERY_SIZE];
+    if (httpd_req_get_url_query_str(req, text, sizeof(text)) == ESP_OK) {
+        if (!rest_query_seconds(text, "from", &from_us) || !rest_query_seconds(text, "to", &to_us)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad cycles query");
+            return ESP_FAIL;
+        }
+    }
+    bool ranged = (from_us != INT64_MIN) || (to_us != INT64_MAX);
+
+    storage_cursor_t cursor;
+    if ((rest_cycle_storage == NULL) ||
+        (storage_cursor_open(rest_cycle_storage, &cursor) != NVM_OK)) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Storage busy");
+        return ESP_OK;
+    }
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    emit_t emit;
+    emit_format_t format = rest_accept_format(req);
+    httpd_resp_set_type(req, emit_content_type(format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    emit_init(&emit, format, &chunk);
+    emit_object_begin(&emit, NULL);
+    emit_array_begin(&emit, "cycles");
+    const char *record;
+    while (!chunk.failed && (storage_cursor_next(cursor, &record) == NVM_OK)) {
+        cycle_result_t cycle;
+        if (!cycle_parse(record, &cycle)) {
+            continue; // padding at the end of a block
+        }
+        int64_t end_time_us = cycle.end_time_s * 1000000;
+        int64_t start_time_us = end_time_us - (cycle.end_us - cycle.start_us);
+        if (ranged && ((cycle.end_time_s == 0) || (end_time_us < from_us) ||
+                       (start_time_us > to_us))) {
+            continue; // outside the range, or no wall-clock time to place it by
+        }
+        emit_object_begin(&emit, NULL);
+        emit_int(&emit, "seq", storage_cursor_sequence(cursor));
+        emit_string(&emit, "phase", cycle.phase == CYCLE_CHARGE ? "charge" : "discharge");
+        if (cycle.end_time_s != 0) {
+            emit_int(&emit, "start_time_s", start_time_us / 1000000);
+            emit_int(&emit, "end_time_s", cycle.end_time_s);
+        }
+        emit_int(&emit, "start_us", cycle.start_us); // since the boot that saw the phase
+        emit_int(&emit, "end_us", cycle.end_us);
+        emit_fixed(&emit, "charge_ah", cycle.charge_uah, 6);
+        emit_fixed(&emit, "energy_wh", cycle.energy_uwh, 6);
+        emit_fixed(&emit, "min_voltage", cycle.min_voltage_mv, 3);
+        emit_fixed(&emit, "max_voltage", cycle.max_voltage_mv, 3);
+        emit_fixed(&emit, "peak_current", cycle.peak_current_ma, 3);
+        emit_object_end(&emit);
+    }
+    storage_cursor_close(cursor);
+    emit_array_end(&emit);
+    emit_object_end(&emit);
+    return rest_finish_chunks(req, emit_finish(&emit));
+}
+
+/* Handler for getting the rolling window statistics of every channel */
+static esp_err_t windows_get_handler(httpd_req_t *req) {
+    window_stats_t windows[REGISTRY_CHANNEL_COUNT][WINDOW_COUNT];
+    int64_t timestamp_us;
+    portENTER_CRITICAL(&rest_windows_lock);
+    memcpy(windows, rest_windows, sizeof(windows));
+    timestamp_us = rest_windows_us;
+    portEXIT_CRITICAL(&rest_windows_lock);
+
+    char buffer[REST_CHUNK_SIZE];
+    chunk_t chunk;
+    emit_t emit;
+    emit_format_t format = rest_accept_format(req);
+    httpd_resp_set_type(req, emit_content_type(format));
+    chunk_init(&chunk, buffer, sizeof(buffer), rest_send_chunk, req);
+    emit_init(&emit, format, &chunk);
+    emit_object_begin(&emit, NULL);
+    emit_int(&emit, "timestamp_us", timestamp_us);
+    emit_object_begin(&emit, "channels");
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        emit_array_begin(&emit, registry_entry(channel)->name);
+        for (uint8_t span = 0; span < WINDOW_COUNT; span++) {
+            const window_stats_t *stats = &windows[channel][span];
+            emit_object_begin(&emit, NULL);
+            emit_int(&emit, "window_s", window_seconds(span));
+            emit_int(&emit, "count", stats->count);
+            if (stats->count) { // an empty window has no statistics yet
+                emit_fixed(&emit, "mean", stats->mean_milli, 3);
+                emit_fixed(&emit, "min", stats->min_milli, 3);
+                emit_fixed(&emit, "max", stats->max_milli, 3);
+            }
+            emit_object_end(&emit);
+        }
+        emit_array_end(&emit);
+    }
+    emit_object_end(&emit);
+    emit_object_end(&emit);
+    return rest_finish_chunks(req, emit_finish(&emit));
+}
+
+/* Handler for manually triggering a burst capture */
+static esp_err_t burst_trigger_post_handler(httpd_req_t *req) {
+    if (!burst_trigger()) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Burst capture in progress");
+        return ESP_OK;
+    }
+    httpd_resp_sendstr(req, "Burst capture triggered");
+    return ESP_OK;
+}
+
+/* Called by the acquisition loop to update the state served by soc_get_handler(), ekf may be NULL */
+void rest_server_publish_soc(const soc_result_t *soc, const ekf_result_t *ekf) {
+    portENTER_CRITICAL(&rest_soc_lock);
+    rest_soc = *soc;
+    if (ekf) {
+        rest_ekf = *ekf;
+    }
+    rest_ekf_valid = (ekf != NULL);
+    portEXIT_CRITICAL(&rest_soc_lock);
+}
+
+/* Called by the acquisition loop after analysing a burst capture */
+void rest_server_publish_spectrum(const spectrum_result_t *spectrum) {
+    portENTER_CRITICAL(&rest_spectrum_lock);
+    rest_spectrum = *spectrum;
+    portEXIT_CRITICAL(&rest_spectrum_lock);
+}
+
+/* Called once the storage ring is open, history and export read from it */
+void rest_server_set_storage(storage_handle_t handle) {
+    rest_storage = handle;
+    rest_boot_nonce = esp_random();
+}
+
+void rest_server_set_cycle_storage(storage_handle_t handle) {
+    rest_cycle_storage = handle;
+}
+
+/* Called by the acquisition loop after updating the rolling windows */
+void rest_server_publish_windows(const window_stats_t windows[REGISTRY_CHANNEL_COUNT][WINDOW_COUNT],
+                                 int64_t timestamp_us) {
+    portENTER_CRITICAL(&rest_windows_lock);
+    memcpy(rest_windows, windows, sizeof(rest_windows));
+    rest_windows_us = timestamp_us;
+    portEXIT_CRITICAL(&rest_windows_lock);
+}
+
+/* Called by the acquisition loop after evaluating the relay rules */
+void rest_server_publish_rules(const rules_stats_t *rules) {
+    portENTER_CRITICAL(&rest_rules_lock);
+    rest_rules = *rules;
+    portEXIT_CRITICAL(&rest_rules_lock);
+}
+
 esp_err_t start_rest_server(const char *base_path) {
     REST_CHECK(base_path, "wrong base path", err);
     rest_server_context_t *rest_context = calloc(1, sizeof(rest_server_context_t));
@@ -234,6 +1024,7 @@ esp_err_t start_rest_server(const char *base_path) {
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.uri_match_fn = httpd_uri_match_wildcard;
+    config.max_uri_handlers = REST_MAX_URI_HANDLERS;
 
     ESP_LOGI(REST_TAG, "Starting HTTP Server");
     REST_CHECK(httpd_start(&server, &config) == ESP_OK, "Start server failed", err_start);
@@ -255,6 +1046,70 @@ esp_err_t start_rest_server(const char *base_path) {
                                             .user_ctx = rest_context};
     httpd_register_uri_handler(server, &temperature_data_get_uri);
 
+    /* URI handler for fetching the latest aggregates and state of charge */
+    httpd_uri_t live_get_uri = {
+        .uri = "/api/v1/live", .method = HTTP_GET, .handler = live_get_handler, .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &live_get_uri);
+
+    /* WebSocket for pushed telemetry */
+    httpd_uri_t stream_ws_uri = {.uri = "/api/v1/stream",
+                                 .method = HTTP_GET,
+                                 .handler = stream_ws_handler,
+                                 .user_ctx = rest_context,
+                                 .is_websocket = true};
+    httpd_register_uri_handler(server, &stream_ws_uri);
+
+    /* URI handler for fetching logged history */
+    httpd_uri_t history_get_uri = {
+        .uri = "/api/v1/history", .method = HTTP_GET, .handler = history_get_handler, .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &history_get_uri);
+
+    /* URI handler for incremental record sync */
+    httpd_uri_t records_get_uri = {
+        .uri = "/api/v1/records", .method = HTTP_GET, .handler = records_get_handler, .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &records_get_uri);
+
+    /* URI handler for downloading the raw storage ring */
+    httpd_uri_t export_raw_get_uri = {.uri = "/api/v1/export/raw",
+                                      .method = HTTP_GET,
+                                      .handler = export_raw_get_handler,
+                                      .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &export_raw_get_uri);
+
+    /* URI handler for fetching the state of charge */
+    httpd_uri_t soc_get_uri = {
+        .uri = "/api/v1/soc", .method = HTTP_GET, .handler = soc_get_handler, .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &soc_get_uri);
+
+    /* URI handler for fetching the latest ripple spectrum */
+    httpd_uri_t spectrum_get_uri = {.uri = "/api/v1/spectrum",
+                                    .method = HTTP_GET,
+                                    .handler = spectrum_get_handler,
+                                    .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &spectrum_get_uri);
+
+    /* URI handler for fetching the relay rule states */
+    httpd_uri_t relays_get_uri = {
+        .uri = "/api/v1/relays", .method = HTTP_GET, .handler = relays_get_handler, .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &relays_get_uri);
+
+    /* URI handler for listing charge and discharge cycles */
+    httpd_uri_t cycles_get_uri = {
+        .uri = "/api/v1/cycles", .method = HTTP_GET, .handler = cycles_get_handler, .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &cycles_get_uri);
+
+    /* URI handler for fetching the rolling window statistics */
+    httpd_uri_t windows_get_uri = {
+        .uri = "/api/v1/windows", .method = HTTP_GET, .handler = windows_get_handler, .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &windows_get_uri);
+
+    /* URI handler for triggering a burst capture */
+    httpd_uri_t burst_trigger_post_uri = {.uri = "/api/v1/burst/trigger",
+                                          .method = HTTP_POST,
+                                          .handler = burst_trigger_post_handler,
+                                          .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &burst_trigger_post_uri);
+
     /* URI handler for light brightness control */
     // httpd_uri_t light_brightness_post_uri = {
     //     .uri = "/api/v1/light/brightness",
@@ -3,11 +3,25 @@
 
 #include "esp_system.h"
 
+#include "ekf.h"
+#include "rules.h"
+#include "soc.h"
+#include "spectrum.h"
+#include "storage.h"
+#include "window.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 esp_err_t start_rest_server(const char *base_path);
+void rest_server_publish_soc(const soc_result_t *soc, const ekf_result_t *ekf);
+void rest_server_publish_spectrum(const spectrum_result_t *spectrum);
+void rest_server_publish_rules(const rules_stats_t *rules);
+void rest_server_publish_windows(const window_stats_t windows[REGISTRY_CHANNEL_COUNT][WINDOW_COUNT],
+                                 int64_t timestamp_us);
+void rest_server_set_storage(storage_handle_t handle);
+void rest_server_set_cycle_storage(storage_handle_t handle);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,144 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "esp_timer.h"
+
+#include "aggregate.h"
+#include "hardware.h"
+#include "registry.h"
+#include "rules.h"
+#include "window.h"
+
+/*
+ * Relay rules, compiled in as a constant table. Each aggregate update runs every rule once: a
+ * compare against the threshold, or the released threshold while the rule is active, a hold
+ * timer and the minimum on / off times. A rule compares either the one second aggregate or a
+ * statistic of one of the rolling windows, which must already hold this second's update. The
+ * cost is bounded by the table size and nothing is allocated.
+ */
+
+#define RULES_MAX 32 // rules_stats_t.active_mask has a bit per rule
+
+static const rules_rule_t rules_table[] = {
+    {
+        // low voltage disconnect of the loads, on the minute's mean so a motor start cannot trip it
+        .channel = REGISTRY_CHANNEL_VOLTAGE,
+        .source = RULES_MEAN,
+        .window = WINDOW_1M,
+        .compare = RULES_BELOW,
+        .threshold_milli = 11800,
+        .hysteresis_milli = 600,
+        .hold_us = 5 * 1000000LL,
+        .relay = HARDWARE_RELAY1,
+        .active_level = 1,
+        .min_active_us = 60 * 1000000LL,
+        .min_inactive_us = 30 * 1000000LL,
+    },
+    {
+        // high voltage disconnect of the charger
+        .channel = REGISTRY_CHANNEL_VOLTAGE,
+        .compare = RULES_ABOVE,
+        .threshold_milli = 14600,
+        .hysteresis_milli = 600,
+        .hold_us = 2 * 1000000LL,
+        .relay = HARDWARE_RELAY2,
+        .active_level = 1,
+        .min_active_us = 60 * 1000000LL,
+        .min_inactive_us = 30 * 1000000LL,
+    },
+};
+
+#define RULES_COUNT (sizeof(rules_table) / sizeof(rules_table[0]))
+
+_Static_assert(RULES_COUNT <= RULES_MAX, "too many relay rules");
+
+typedef struct rules_state_t {
+    bool active;
+    int64_t pending_since_us; // when the condition to change state was first seen, zero if not
+    int64_t changed_us;
+} rules_state_t;
+
+static rules_state_t rules_state[RULES_COUNT];
+static rules_stats_t rules_stats;
+
+static bool rules_condition(const rules_rule_t *rule, bool active, int32_t value) {
+    int32_t threshold = rule->threshold_milli;
+    if (active) { // stay active until the value is back past the hysteresis band
+        threshold += rule->compare == RULES_BELOW ? rule->hysteresis_milli : -rule->hysteresis_milli;
+    }
+    return rule->compare == RULES_BELOW ? value < threshold : value > threshold;
+}
+
+/* The value a rule compares, false if its window is still empty */
+static bool rules_value(const rules_rule_t *rule, const aggregate_result_t *result,
+                        int32_t *value) {
+    if (rule->source == RULES_LATEST) {
+        *value = result->value_milli;
+        return true;
+    }
+    window_stats_t stats;
+    window_get_span(rule->channel, rule->window, &stats);
+    if (stats.count == 0) {
+        return false;
+    }
+    *value = rule->source == RULES_MEAN  ? stats.mean_milli
+             : rule->source == RULES_MIN ? stats.min_milli
+                                         : stats.max_milli;
+    return true;
+}
+
+void rules_init(void) {
+    memset(rules_state, 0, sizeof(rules_state));
+    memset(&rules_stats, 0, sizeof(rules_stats));
+    for (uint8_t i = 0; i < RULES_COUNT; i++) {
+        gpio_set_level(rules_table[i].relay, !rules_table[i].active_level);
+    }
+}
+
+void rules_evaluate(const aggregate_result_t results[REGISTRY_CHANNEL_COUNT], int64_t now_us) {
+    for (uint8_t i = 0; i < RULES_COUNT; i++) {
+        const rules_rule_t *rule = &rules_table[i];
+        rules_state_t *state = &rules_state[i];
+        const aggregate_result_t *result = &results[rule->channel];
+        int32_t value;
+        if ((result->count == 0) || !rules_value(rule, result, &value)) {
+            continue; // no news, hold the current state
+        }
+        bool wanted = rules_condition(rule, state->active, value);
+        if (wanted == state->active) {
+            state->pending_since_us = 0;
+            continue;
+        }
+        if (state->pending_since_us == 0) {
+            state->pending_since_us = result->latest_us;
+        }
+        int64_t minimum = state->active ? rule->min_active_us : rule->min_inactive_us;
+        if ((result->latest_us - state->pending_since_us < (wanted ? rule->hold_us : 0)) ||
+            ((state->changed_us != 0) && (now_us - state->changed_us < minimum))) {
+            continue;
+        }
+        gpio_set_level(rule->relay, wanted ? rule->active_level : !rule->active_level);
+        int64_t latency_us = esp_timer_get_time() - result->latest_us;
+        state->active = wanted;
+        state->pending_since_us = 0;
+        state->changed_us = now_us;
+        rules_stats.changes++;
+        rules_stats.last_latency_us = latency_us;
+        if (latency_us > rules_stats.max_latency_us) {
+            rules_stats.max_latency_us = latency_us;
+        }
+        if (wanted) {
+            rules_stats.active_mask |= 1UL << i;
+        } else {
+            rules_stats.active_mask &= ~(1UL << i);
+        }
+    }
+}
+
+void rules_get(rules_stats_t *stats) { *stats = rules_stats; }
+
+uint8_t rules_count(void) { return RULES_COUNT; }
+
+const rules_rule_t *rules_rule(uint8_t index) { return &rules_table[index]; }
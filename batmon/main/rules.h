@@ -0,0 +1,59 @@
+#ifndef RULES_H
+#define RULES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "aggregate.h"
+#include "hardware.h"
+#include "registry.h"
+#include "window.h"
+
+typedef enum {
+    RULES_BELOW = 0,
+    RULES_ABOVE,
+} rules_compare_t;
+
+typedef enum {
+    RULES_LATEST = 0, // the one second aggregate
+    RULES_MEAN,       // statistics of the rule's window
+    RULES_MIN,
+    RULES_MAX,
+} rules_source_t;
+
+typedef struct rules_rule_t {
+    uint8_t channel;
+    rules_source_t source;
+    window_span_t window; // for every source but RULES_LATEST
+    rules_compare_t compare;
+    int32_t threshold_milli;  // condition is value below / above this
+    int32_t hysteresis_milli; // released once value is this far back past the threshold
+    int64_t hold_us;          // condition must persist this long before the relay moves
+    gpio_num_t relay;
+    uint8_t active_level; // relay level while the rule is active
+    int64_t min_active_us; // shortest time the relay stays in each state
+    int64_t min_inactive_us;
+} rules_rule_t;
+
+typedef struct rules_stats_t {
+    uint32_t changes;
+    int64_t last_latency_us; // newest frame of the deciding aggregate to the relay change
+    int64_t max_latency_us;
+    uint32_t active_mask; // bit per rule in rules_table order
+} rules_stats_t;
+
+void rules_init(void);
+void rules_evaluate(const aggregate_result_t results[REGISTRY_CHANNEL_COUNT], int64_t now_us);
+void rules_get(rules_stats_t *stats);
+uint8_t rules_count(void);
+const rules_rule_t *rules_rule(uint8_t index);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* RULES_H_ */
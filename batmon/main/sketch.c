@@ -0,0 +1,177 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "aggregate.h"
+#include "registry.h"
+#include "sketch.h"
+
+/*
+ * Per channel streaming statistics in constant memory: Welford's running mean and variance,
+ * and a P-squared estimator (Jain and Chlamtac, 1985) for each tracked quantile. Everything
+ * is kept in raw counts and scaled to milli-units only when a period is flushed.
+ */
+
+#define SKETCH_MARKERS 5
+
+static const float sketch_quantile_p[SKETCH_QUANTILE_COUNT] = {
+    [SKETCH_P1] = 0.01f,
+    [SKETCH_P50] = 0.50f,
+    [SKETCH_P99] = 0.99f,
+};
+
+typedef struct sketch_p2_t {
+    float height[SKETCH_MARKERS];
+    float desired[SKETCH_MARKERS];
+    int32_t position[SKETCH_MARKERS];
+} sketch_p2_t;
+
+typedef struct sketch_t {
+    uint32_t count;
+    float mean;
+    float m2;
+    sketch_p2_t quantile[SKETCH_QUANTILE_COUNT];
+} sketch_t;
+
+static sketch_t sketch_state[REGISTRY_CHANNEL_COUNT];
+
+static void sketch_p2_start(sketch_p2_t *p2, float p) {
+    // the first five samples are held sorted in height[] until the markers can be placed
+    for (int i = 0; i < SKETCH_MARKERS; i++) {
+        p2->position[i] = i;
+    }
+    p2->desired[0] = 0;
+    p2->desired[1] = 2 * p;
+    p2->desired[2] = 4 * p;
+    p2->desired[3] = 2 + 2 * p;
+    p2->desired[4] = 4;
+}
+
+static float sketch_p2_parabolic(const sketch_p2_t *p2, int i, int d) {
+    const float *q = p2->height;
+    const int32_t *n = p2->position;
+    return q[i] + (float)d / (n[i + 1] - n[i - 1]) *
+                      ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                       (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+static void sketch_p2_add(sketch_p2_t *p2, float p, uint32_t count, float x) {
+    float *q = p2->height;
+    int32_t *n = p2->position;
+    if (count < SKETCH_MARKERS) {
+        int i = count; // insertion sort into the initial samples
+        while ((i > 0) && (q[i - 1] > x)) {
+            q[i] = q[i - 1];
+            i--;
+        }
+        q[i] = x;
+        return;
+    }
+    int k;
+    if (x < q[0]) {
+        q[0] = x;
+        k = 0;
+    } else if (x >= q[4]) {
+        q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (x >= q[k + 1]) {
+            k++;
+        }
+    }
+    for (int i = k + 1; i < SKETCH_MARKERS; i++) {
+        n[i]++;
+    }
+    p2->desired[1] += p / 2;
+    p2->desired[2] += p;
+    p2->desired[3] += (1 + p) / 2;
+    p2->desired[4] += 1;
+    for (int i = 1; i < SKETCH_MARKERS - 1; i++) {
+        float delta = p2->desired[i] - n[i];
+        if (((delta >= 1) && (n[i + 1] - n[i] > 1)) || ((delta <= -1) && (n[i - 1] - n[i] < -1))) {
+            int d = delta > 0 ? 1 : -1;
+            float height = sketch_p2_parabolic(p2, i, d);
+            if ((q[i - 1] >= height) || (height >= q[i + 1])) {
+                height = q[i] + d * (q[i + d] - q[i]) / (n[i + d] - n[i]);
+            }
+            q[i] = height;
+            n[i] += d;
+        }
+    }
+}
+
+static float sketch_p2_get(const sketch_p2_t *p2, float p, uint32_t count) {
+    if (count >= SKETCH_MARKERS) {
+        return p2->height[2];
+    }
+    return p2->height[(int)(p * (count - 1) + 0.5f)]; // nearest rank of the sorted samples
+}
+
+static void sketch_reset(sketch_t *sketch) {
+    memset(sketch, 0, sizeof(sketch_t));
+    for (int q = 0; q < SKETCH_QUANTILE_COUNT; q++) {
+        sketch_p2_start(&sketch->quantile[q], sketch_quantile_p[q]);
+    }
+}
+
+void sketch_init(void) {
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        sketch_reset(&sketch_state[channel]);
+    }
+}
+
+void sketch_add(uint8_t device_id, int16_t value) {
+    uint8_t channel = registry_channel(device_id);
+    if (channel == REGISTRY_NO_CHANNEL) {
+        return;
+    }
+    sketch_t *sketch = &sketch_state[channel];
+    float x = value;
+    for (int q = 0; q < SKETCH_QUANTILE_COUNT; q++) {
+        sketch_p2_add(&sketch->quantile[q], sketch_quantile_p[q], sketch->count, x);
+    }
+    sketch->count++;
+    float delta = x - sketch->mean;
+    sketch->mean += delta / sketch->count;
+    sketch->m2 += delta * (x - sketch->mean);
+}
+
+/* Report and restart the sketches, call once per reporting period */
+void sketch_flush(sketch_result_t results[REGISTRY_CHANNEL_COUNT]) {
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        sketch_t *sketch = &sketch_state[channel];
+        sketch_result_t *result = &results[channel];
+        memset(result, 0, sizeof(sketch_result_t));
+        result->count = sketch->count;
+        if (sketch->count > 0) {
+            float stddev = sketch->count > 1 ? sqrtf(sketch->m2 / (sketch->count - 1)) : 0;
+            result->mean_milli = aggregate_scale(channel, lrintf(sketch->mean * 1000), 1000);
+            result->stddev_milli = aggregate_scale(channel, lrintf(stddev * 1000), 1000);
+            for (int q = 0; q < SKETCH_QUANTILE_COUNT; q++) {
+                float height =
+                    sketch_p2_get(&sketch->quantile[q], sketch_quantile_p[q], sketch->count);
+                result->quantile_milli[q] = aggregate_scale(channel, lrintf(height * 1000), 1000);
+            }
+        }
+        sketch_reset(sketch);
+    }
+}
+
+/* Serialise as "Q,channel,timestamp_us,count,mean,stddev,p1,p50,p99" for the storage ring */
+int sketch_serialise(char *buffer, size_t size, uint8_t channel, int64_t timestamp_us,
+                     const sketch_result_t *result) {
+    int32_t fields[2 + SKETCH_QUANTILE_COUNT] = {result->mean_milli, result->stddev_milli};
+    memcpy(&fields[2], result->quantile_milli, sizeof(result->quantile_milli));
+    int length = snprintf(buffer, size, SKETCH_RECORD_TAG ",%d,%lld,%lu", channel,
+                          (long long)timestamp_us, (unsigned long)result->count);
+    for (int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (length + 1 >= size) {
+            break;
+        }
+        buffer[length++] = ',';
+        length += aggregate_format_milli(&buffer[length], size - length, fields[i]);
+    }
+    return length;
+}
@@ -0,0 +1,39 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "registry.h"
+
+#define SKETCH_RECORD_TAG "Q"
+
+typedef enum {
+    SKETCH_P1 = 0,
+    SKETCH_P50,
+    SKETCH_P99,
+    SKETCH_QUANTILE_COUNT,
+} sketch_quantile_t;
+
+typedef struct sketch_result_t {
+    uint32_t count;
+    int32_t mean_milli;
+    int32_t stddev_milli;
+    int32_t quantile_milli[SKETCH_QUANTILE_COUNT];
+} sketch_result_t;
+
+void sketch_init(void);
+void sketch_add(uint8_t device_id, int16_t value);
+void sketch_flush(sketch_result_t results[REGISTRY_CHANNEL_COUNT]);
+int sketch_serialise(char *buffer, size_t size, uint8_t channel, int64_t timestamp_us,
+                     const sketch_result_t *result);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* SKETCH_H_ */
@@ -0,0 +1,156 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "aggregate.h"
+#include "power.h"
+#include "registry.h"
+#include "soc.h"
+
+/*
+ * Coulomb counter. Current frames are integrated with the trapezoidal rule against their
+ * reception timestamps. Each trapezoid is accumulated exactly as (i0 + i1) * dt, twice the
+ * area, and whole micro-amp-hours are carried out of the residue so nothing is ever rounded.
+ * Charge in and out are counted separately so the charge efficiency is applied once, when the
+ * state of charge is computed, rather than truncated into every sample. Energy is integrated
+ * from paired current and voltage by power.c and reported alongside.
+ */
+
+#define SOC_UAH_DOUBLED (2LL * 3600LL * 1000LL) // twice the mA.us in one uAh
+#define SOC_INITIAL_PERMILLE 500                 // best guess until the first full charge
+
+static const soc_config_t soc_default_config = {
+    .capacity_mah = 100000,
+    .charge_efficiency_permille = 980,
+    .full_voltage_mv = 14200,
+    .full_current_ma = 2000,
+    .full_hold_us = 60 * 1000000LL,
+    .max_gap_us = 10 * 1000000LL,
+};
+
+typedef struct soc_counter_t {
+    int64_t units;
+    int64_t residue;
+} soc_counter_t;
+
+typedef struct soc_ctx_t {
+    soc_config_t config;
+    int32_t current_ma;
+    int32_t voltage_mv;
+    int64_t current_timestamp_us;
+    bool have_current;
+    bool have_voltage;
+    int64_t full_since_us;
+    soc_counter_t charge_in;
+    soc_counter_t charge_out;
+    int64_t charge_in_at_full_uah; // counter values when the baseline was last set
+    int64_t charge_out_at_full_uah;
+    int64_t baseline_uah; // charge held in the battery at the baseline
+    int64_t full_timestamp_us;
+    bool synchronised;
+} soc_ctx_t;
+
+static soc_ctx_t soc_ctx;
+
+static void soc_accumulate(soc_counter_t *counter, int64_t increment, int64_t unit) {
+    counter->residue += increment;
+    if (counter->residue >= unit) {
+        int64_t units = counter->residue / unit;
+        counter->units += units;
+        counter->residue -= units * unit;
+    }
+}
+
+static void soc_set_baseline(soc_ctx_t *ctx, int64_t baseline_uah) {
+    ctx->charge_in_at_full_uah = ctx->charge_in.units;
+    ctx->charge_out_at_full_uah = ctx->charge_out.units;
+    ctx->baseline_uah = baseline_uah;
+}
+
+static void soc_check_full(soc_ctx_t *ctx, int64_t timestamp_us) {
+    if ((ctx->voltage_mv >= ctx->config.full_voltage_mv) && (ctx->current_ma >= 0) &&
+        (ctx->current_ma <= ctx->config.full_current_ma)) {
+        if (ctx->full_since_us == 0) {
+            ctx->full_since_us = timestamp_us;
+        } else if (timestamp_us - ctx->full_since_us >= ctx->config.full_hold_us) {
+            soc_set_baseline(ctx, (int64_t)ctx->config.capacity_mah * 1000);
+            ctx->full_timestamp_us = timestamp_us;
+            ctx->synchronised = true;
+            ctx->full_since_us = timestamp_us; // keep resynchronising while the battery floats
+        }
+    } else {
+        ctx->full_since_us = 0;
+    }
+}
+
+void soc_init(const soc_config_t *config) {
+    memset(&soc_ctx, 0, sizeof(soc_ctx));
+    soc_ctx.config = config ? *config : soc_default_config;
+    soc_set_baseline(&soc_ctx, (int64_t)soc_ctx.config.capacity_mah * SOC_INITIAL_PERMILLE);
+}
+
+void soc_add(uint8_t device_id, int16_t value, int64_t timestamp_us) {
+    soc_ctx_t *ctx = &soc_ctx;
+    uint8_t channel = registry_channel(device_id);
+    if (channel == REGISTRY_CHANNEL_VOLTAGE) {
+        ctx->voltage_mv = aggregate_scale(channel, value, 1);
+        ctx->have_voltage = true;
+        return;
+    }
+    if (channel != REGISTRY_CHANNEL_CURRENT) {
+        return;
+    }
+    int32_t current_ma = aggregate_scale(channel, value, 1);
+    int64_t dt_us = timestamp_us - ctx->current_timestamp_us;
+    if (ctx->have_current && (dt_us > 0) && (dt_us <= ctx->config.max_gap_us)) {
+        int64_t charge = ((int64_t)ctx->current_ma + current_ma) * dt_us;
+        if (charge >= 0) {
+            soc_accumulate(&ctx->charge_in, charge, SOC_UAH_DOUBLED);
+        } else {
+            soc_accumulate(&ctx->charge_out, -charge, SOC_UAH_DOUBLED);
+        }
+    }
+    ctx->current_ma = current_ma;
+    ctx->current_timestamp_us = timestamp_us;
+    ctx->have_current = true;
+    if (ctx->have_voltage) {
+        soc_check_full(ctx, timestamp_us);
+    }
+}
+
+void soc_get(soc_result_t *result) {
+    const soc_ctx_t *ctx = &soc_ctx;
+    int64_t capacity_uah = (int64_t)ctx->config.capacity_mah * 1000;
+    int64_t charged_uah = ((ctx->charge_in.units - ctx->charge_in_at_full_uah) *
+                           ctx->config.charge_efficiency_permille) / 1000;
+    int64_t discharged_uah = ctx->charge_out.units - ctx->charge_out_at_full_uah;
+    int64_t remaining_uah = ctx->baseline_uah + charged_uah - discharged_uah;
+    if (remaining_uah < 0) {
+        remaining_uah = 0;
+    }
+    if (remaining_uah > capacity_uah) {
+        remaining_uah = capacity_uah;
+    }
+    result->timestamp_us = ctx->current_timestamp_us;
+    result->full_timestamp_us = ctx->full_timestamp_us;
+    result->synchronised = ctx->synchronised;
+    result->soc_permille = capacity_uah > 0 ? (remaining_uah * 1000) / capacity_uah : 0;
+    result->remaining_mah = remaining_uah / 1000;
+    result->charge_in_uah = ctx->charge_in.units;
+    result->charge_out_uah = ctx->charge_out.units;
+    power_result_t power;
+    power_get(&power);
+    result->energy_in_uwh = power.energy_in_uwh;
+    result->energy_out_uwh = power.energy_out_uwh;
+}
+
+/* Serialise as "C,timestamp_us,soc_permille,synchronised,remaining_mah,in_uah,out_uah,in_uwh,
+ * out_uwh" for the storage ring */
+int soc_serialise(char *buffer, size_t size, const soc_result_t *result) {
+    return snprintf(buffer, size, SOC_RECORD_TAG ",%lld,%d,%d,%ld,%lld,%lld,%lld,%lld",
+                    (long long)result->timestamp_us, result->soc_permille, result->synchronised,
+                    (long)result->remaining_mah, (long long)result->charge_in_uah,
+                    (long long)result->charge_out_uah, (long long)result->energy_in_uwh,
+                    (long long)result->energy_out_uwh);
+}
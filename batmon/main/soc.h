@@ -0,0 +1,44 @@
+#ifndef SOC_H
+#define SOC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SOC_RECORD_TAG "C"
+
+typedef struct soc_config_t {
+    int32_t capacity_mah;
+    uint16_t charge_efficiency_permille; // fraction of charge in that can be taken out again
+    int32_t full_voltage_mv;             // battery is full once voltage stays at or above this
+    int32_t full_current_ma;             // while the charge current has tailed off below this
+    int64_t full_hold_us;                // for at least this long
+    int64_t max_gap_us;                  // longer gaps between current frames are not integrated
+} soc_config_t;
+
+typedef struct soc_result_t {
+    int64_t timestamp_us;      // last current frame integrated
+    int64_t full_timestamp_us; // last resynchronisation to full, zero if never
+    bool synchronised;
+    int16_t soc_permille;
+    int32_t remaining_mah;
+    int64_t charge_in_uah; // totals since boot
+    int64_t charge_out_uah;
+    int64_t energy_in_uwh;
+    int64_t energy_out_uwh;
+} soc_result_t;
+
+void soc_init(const soc_config_t *config);
+void soc_add(uint8_t device_id, int16_t value, int64_t timestamp_us);
+void soc_get(soc_result_t *result);
+int soc_serialise(char *buffer, size_t size, const soc_result_t *result);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* SOC_H_ */
@@ -0,0 +1,259 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "aggregate.h"
+#include "burst.h"
+#include "registry.h"
+#include "spectrum.h"
+
+/*
+ * Fixed-point real FFT. The N real samples are treated as N/2 complex samples, transformed in
+ * place by an iterative radix-2 decimation in time FFT and then split into the N/2 + 1 bins of
+ * the real transform. Arithmetic is Q15 with block floating point: before each stage the data
+ * is halved if any component could overflow, and the returned exponent says how many times.
+ * The twiddles come from a quarter wave sine table sized for SPECTRUM_MAX_POINTS.
+ */
+
+#define SPECTRUM_QUARTER (SPECTRUM_MAX_POINTS / 4)
+#define SPECTRUM_HEADROOM 8191 // largest component that cannot overflow in a butterfly
+
+static int16_t spectrum_sine[SPECTRUM_QUARTER + 1];
+static int16_t spectrum_data[SPECTRUM_MAX_POINTS];
+
+/* sin(2 pi index / SPECTRUM_MAX_POINTS) in Q15 */
+static inline int32_t spectrum_sin(uint32_t index) {
+    index &= SPECTRUM_MAX_POINTS - 1;
+    uint32_t quadrant = index / SPECTRUM_QUARTER;
+    uint32_t offset = index % SPECTRUM_QUARTER;
+    switch (quadrant) {
+        case 0:
+            return spectrum_sine[offset];
+        case 1:
+            return spectrum_sine[SPECTRUM_QUARTER - offset];
+        case 2:
+            return -spectrum_sine[offset];
+        default:
+            return -spectrum_sine[SPECTRUM_QUARTER - offset];
+    }
+}
+
+static inline int32_t spectrum_cos(uint32_t index) { return spectrum_sin(index + SPECTRUM_QUARTER); }
+
+static int32_t spectrum_max_abs(const int16_t *data, uint32_t count) {
+    int32_t max = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t value = data[i] < 0 ? -data[i] : data[i];
+        max = value > max ? value : max;
+    }
+    return max;
+}
+
+static void spectrum_halve(int16_t *data, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        data[i] >>= 1;
+    }
+}
+
+static void spectrum_bit_reverse(int16_t *data, uint32_t complex_points) {
+    for (uint32_t i = 1, j = 0; i < complex_points; i++) {
+        uint32_t bit = complex_points >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            int16_t re = data[2 * i];
+            int16_t im = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = re;
+            data[2 * j + 1] = im;
+        }
+    }
+}
+
+void spectrum_init(void) {
+    for (uint32_t i = 0; i <= SPECTRUM_QUARTER; i++) {
+        spectrum_sine[i] = lrintf(32767.0f * sinf(2.0f * (float)M_PI * i / SPECTRUM_MAX_POINTS));
+    }
+}
+
+/*
+ * Transform points real samples in place, points a power of two from SPECTRUM_MIN_POINTS to
+ * SPECTRUM_MAX_POINTS. On return data[0] holds the DC bin, data[1] the Nyquist bin and
+ * data[2k], data[2k+1] the real and imaginary parts of bin k. Every bin must be multiplied by
+ * 2^exponent, the return value, to get the unscaled DFT.
+ */
+int spectrum_fft(int16_t *data, uint32_t points) {
+    uint32_t complex_points = points / 2;
+    int exponent = 0;
+
+    spectrum_bit_reverse(data, complex_points);
+    for (uint32_t length = 2; length <= complex_points; length <<= 1) {
+        if (spectrum_max_abs(data, points) > SPECTRUM_HEADROOM) {
+            spectrum_halve(data, points);
+            exponent++;
+        }
+        uint32_t half = length / 2;
+        uint32_t stride = SPECTRUM_MAX_POINTS / length;
+        for (uint32_t start = 0; start < complex_points; start += length) {
+            int16_t *a = &data[2 * start];
+            int16_t *b = &data[2 * (start + half)];
+            for (uint32_t j = 0; j < half; j++) {
+                int32_t wr = spectrum_cos(j * stride);
+                int32_t wi = -spectrum_sin(j * stride);
+                int32_t tr = (b[2 * j] * wr - b[2 * j + 1] * wi + (1 << 14)) >> 15;
+                int32_t ti = (b[2 * j] * wi + b[2 * j + 1] * wr + (1 << 14)) >> 15;
+                int32_t ar = a[2 * j];
+                int32_t ai = a[2 * j + 1];
+                a[2 * j] = ar + tr;
+                a[2 * j + 1] = ai + ti;
+                b[2 * j] = ar - tr;
+                b[2 * j + 1] = ai - ti;
+            }
+        }
+    }
+
+    // split into the real transform, halving once more to keep the result in range
+    if (spectrum_max_abs(data, points) > SPECTRUM_HEADROOM) {
+        spectrum_halve(data, points);
+        exponent++;
+    }
+    int32_t dc = data[0];
+    int32_t nyquist = data[1];
+    data[0] = (dc + nyquist) >> 1;
+    data[1] = (dc - nyquist) >> 1;
+    uint32_t stride = SPECTRUM_MAX_POINTS / points;
+    for (uint32_t k = 1; k <= complex_points / 2; k++) {
+        uint32_t m = complex_points - k;
+        int32_t zkr = data[2 * k], zki = data[2 * k + 1];
+        int32_t zmr = data[2 * m], zmi = data[2 * m + 1];
+        // fe = (z[k] + conj(z[m])) / 2, fo = (z[k] - conj(z[m])) / 2j, both times two here
+        int32_t fer = zkr + zmr;
+        int32_t fei = zki - zmi;
+        int32_t for_ = zki + zmi;
+        int32_t foi = zmr - zkr;
+        int32_t wr = spectrum_cos(k * stride);
+        int32_t wi = -spectrum_sin(k * stride);
+        int32_t tr = (for_ * wr - foi * wi + (1 << 14)) >> 15;
+        int32_t ti = (for_ * wi + foi * wr + (1 << 14)) >> 15;
+        // x[k] = fe + w fo, x[m] = conj(fe - w fo), divided by two and halved for headroom
+        data[2 * k] = (fer + tr) >> 2;
+        data[2 * k + 1] = (fei + ti) >> 2;
+        data[2 * m] = (fer - tr) >> 2;
+        data[2 * m + 1] = -(fei - ti) >> 2;
+    }
+    return exponent + 1;
+}
+
+/* Resample the frames of one channel from the frozen burst onto a uniform grid */
+static uint32_t spectrum_resample(uint8_t channel, int64_t *start_us, int64_t *period_ns,
+                                  int *shift) {
+    uint8_t device_id = registry_entry(channel)->device_id;
+    uint32_t frames = burst_frame_count();
+    uint32_t count = 0;
+    int64_t first_us = 0, last_us = 0, sum = 0;
+    int32_t min = INT16_MAX, max = INT16_MIN;
+    for (uint32_t i = 0; i < frames; i++) {
+        const burst_frame_t *frame = burst_frame(i);
+        if (frame->device_id == device_id) {
+            first_us = count == 0 ? frame->timestamp_us : first_us;
+            last_us = frame->timestamp_us;
+            sum += frame->value;
+            min = frame->value < min ? frame->value : min;
+            max = frame->value > max ? frame->value : max;
+            count++;
+        }
+    }
+    if ((count < SPECTRUM_MIN_POINTS / 2) || (last_us <= first_us)) {
+        return 0;
+    }
+    uint32_t points = SPECTRUM_MIN_POINTS;
+    while ((points < count) && (points < SPECTRUM_MAX_POINTS)) {
+        points <<= 1;
+    }
+
+    // remove the mean and scale so the largest deviation fits the headroom
+    int32_t mean = sum / count;
+    int32_t deviation = (max - mean) > (mean - min) ? (max - mean) : (mean - min);
+    *shift = 0;
+    while ((deviation >> *shift) > SPECTRUM_HEADROOM) {
+        (*shift)++;
+    }
+    *start_us = first_us;
+    *period_ns = ((last_us - first_us) * 1000) / (points - 1);
+
+    // linear interpolation between neighbouring frames, with a Hann window
+    uint32_t cursor = 0;
+    const burst_frame_t *previous = NULL;
+    const burst_frame_t *next = NULL;
+    for (uint32_t i = 0; i < points; i++) {
+        int64_t t_us = first_us + (*period_ns * i) / 1000;
+        while ((cursor < frames) && ((next == NULL) || (next->timestamp_us < t_us))) {
+            const burst_frame_t *frame = burst_frame(cursor++);
+            if (frame->device_id == device_id) {
+                previous = next ? next : frame;
+                next = frame;
+            }
+        }
+        int32_t value = next->value;
+        if ((next->timestamp_us > t_us) && (next->timestamp_us > previous->timestamp_us)) {
+            value = previous->value + ((int64_t)(next->value - previous->value) *
+                                       (t_us - previous->timestamp_us)) /
+                                          (next->timestamp_us - previous->timestamp_us);
+        }
+        int32_t window = (32768 - spectrum_cos((SPECTRUM_MAX_POINTS / points) * i)) >> 1;
+        spectrum_data[i] = (((value - mean) >> *shift) * window) >> 15;
+    }
+    return points;
+}
+
+/* Analyse the frozen burst, call before it is drained by burst_serialise() */
+bool spectrum_analyse_burst(uint8_t channel, spectrum_result_t *result) {
+    int64_t start_us, period_ns;
+    int shift;
+    uint32_t points = spectrum_resample(channel, &start_us, &period_ns, &shift);
+    if ((points == 0) || (period_ns <= 0)) {
+        return false;
+    }
+    int exponent = spectrum_fft(spectrum_data, points) + shift;
+
+    memset(result, 0, sizeof(spectrum_result_t));
+    result->timestamp_us = start_us;
+    result->channel = channel;
+    result->points = points;
+    result->sample_rate_mhz = 1000000000000LL / period_ns;
+
+    // keep the largest local maxima, skipping DC and the bins next to it
+    int64_t power[SPECTRUM_PEAKS] = {0};
+    uint32_t bins[SPECTRUM_PEAKS] = {0};
+    int64_t before = 0;
+    int64_t here = 0;
+    for (uint32_t k = 2; k < points / 2; k++) {
+        int64_t re = spectrum_data[2 * k], im = spectrum_data[2 * k + 1];
+        int64_t after = re * re + im * im;
+        if ((k > 2) && (here > before) && (here >= after) && (here > power[SPECTRUM_PEAKS - 1])) {
+            int slot = SPECTRUM_PEAKS - 1;
+            while ((slot > 0) && (here > power[slot - 1])) {
+                power[slot] = power[slot - 1];
+                bins[slot] = bins[slot - 1];
+                slot--;
+            }
+            power[slot] = here;
+            bins[slot] = k - 1;
+        }
+        before = here;
+        here = after;
+    }
+    for (int i = 0; (i < SPECTRUM_PEAKS) && (power[i] > 0); i++) {
+        // a Hann windowed tone of amplitude a has a bin magnitude of a * points / 4
+        float magnitude = sqrtf((float)power[i]) * ldexpf(1.0f, exponent);
+        int64_t amplitude_raw = lrintf(4.0f * magnitude / points);
+        result->peaks[i].frequency_mhz = ((uint64_t)bins[i] * result->sample_rate_mhz) / points;
+        result->peaks[i].amplitude_milli = aggregate_scale(channel, amplitude_raw, 1);
+        result->peak_count++;
+    }
+    return true;
+}
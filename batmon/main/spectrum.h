@@ -0,0 +1,37 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SPECTRUM_MIN_POINTS 16
+#define SPECTRUM_MAX_POINTS 4096
+#define SPECTRUM_PEAKS 5
+
+typedef struct spectrum_peak_t {
+    uint32_t frequency_mhz; // milli-hertz
+    int32_t amplitude_milli; // peak amplitude in milli-units of the channel
+} spectrum_peak_t;
+
+typedef struct spectrum_result_t {
+    int64_t timestamp_us; // first frame of the analysed burst
+    uint8_t channel;
+    uint16_t points;
+    uint32_t sample_rate_mhz;
+    uint8_t peak_count;
+    spectrum_peak_t peaks[SPECTRUM_PEAKS]; // largest first
+} spectrum_result_t;
+
+void spectrum_init(void);
+int spectrum_fft(int16_t *data, uint32_t points);
+bool spectrum_analyse_burst(uint8_t channel, spectrum_result_t *result);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* SPECTRUM_H_ */
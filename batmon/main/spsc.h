@@ -0,0 +1,125 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Lock-free single producer / single consumer ring of fixed size items. The producer owns
+ * head and the consumer owns tail; each publishes its index with a release store and reads
+ * the other's with an acquire load, so items are complete before they become visible and are
+ * not overwritten until they have been consumed. The count must be a power of two.
+ *
+ * Items can be moved in batches without copying: spsc_reserve() / spsc_commit() hand the
+ * producer a contiguous run of free slots to fill in place, and spsc_peek() / spsc_release()
+ * hand the consumer a contiguous run of filled ones. Everything is inline so the producer side
+ * can be used from an IRAM interrupt handler.
+ */
+
+#define SPSC_CACHE_LINE 64
+
+typedef struct spsc_t {
+    _Alignas(SPSC_CACHE_LINE) atomic_uint_least32_t head; // items committed since init
+    _Alignas(SPSC_CACHE_LINE) atomic_uint_least32_t tail; // items released since init
+    uint32_t mask;
+    uint32_t item_size;
+    uint8_t *items;
+} spsc_t;
+
+#define SPSC_INITIALISER(storage, size, count)                                                     \
+    { .head = 0, .tail = 0, .mask = (count)-1, .item_size = (size), .items = (uint8_t *)(storage) }
+
+/* Define a ring of count items of type with static storage */
+#define SPSC_DEFINE(name, type, count)                                                             \
+    _Static_assert(((count) & ((count)-1)) == 0, "spsc count must be a power of two");             \
+    static type name##_storage[count];                                                             \
+    static spsc_t name = SPSC_INITIALISER(name##_storage, sizeof(type), count)
+
+static inline bool spsc_init(spsc_t *ring, void *storage, uint32_t item_size, uint32_t count) {
+    if ((count == 0) || (count & (count - 1))) {
+        return false;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->mask = count - 1;
+    ring->item_size = item_size;
+    ring->items = storage;
+    return true;
+}
+
+static inline void *spsc_item(const spsc_t *ring, uint32_t index) {
+    return &ring->items[(index & ring->mask) * ring->item_size];
+}
+
+/* Producer: point items at up to count contiguous free slots, returning how many */
+static inline uint32_t spsc_reserve(spsc_t *ring, void **items, uint32_t count) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t free = ring->mask + 1 - (head - tail);
+    uint32_t contiguous = ring->mask + 1 - (head & ring->mask);
+    count = count < free ? count : free;
+    count = count < contiguous ? count : contiguous;
+    *items = spsc_item(ring, head);
+    return count;
+}
+
+/* Producer: publish count slots filled since the last spsc_reserve() */
+static inline void spsc_commit(spsc_t *ring, uint32_t count) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+}
+
+/* Consumer: point items at up to count contiguous filled slots, returning how many */
+static inline uint32_t spsc_peek(spsc_t *ring, void **items, uint32_t count) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t used = head - tail;
+    uint32_t contiguous = ring->mask + 1 - (tail & ring->mask);
+    count = count < used ? count : used;
+    count = count < contiguous ? count : contiguous;
+    *items = spsc_item(ring, tail);
+    return count;
+}
+
+/* Consumer: hand count slots read since the last spsc_peek() back to the producer */
+static inline void spsc_release(spsc_t *ring, uint32_t count) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+}
+
+static inline bool spsc_push(spsc_t *ring, const void *item) {
+    void *slot;
+    if (spsc_reserve(ring, &slot, 1) == 0) {
+        return false;
+    }
+    memcpy(slot, item, ring->item_size);
+    spsc_commit(ring, 1);
+    return true;
+}
+
+static inline bool spsc_pop(spsc_t *ring, void *item) {
+    void *slot;
+    if (spsc_peek(ring, &slot, 1) == 0) {
+        return false;
+    }
+    memcpy(item, slot, ring->item_size);
+    spsc_release(ring, 1);
+    return true;
+}
+
+static inline uint32_t spsc_used(spsc_t *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* SPSC_H_ */
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
@@ -27,6 +28,11 @@ typedef struct storage_block_t {
     uint8_t data[STORAGE_DATA_SIZE];
 } storage_block_t;
 
+// every record takes at least its terminator, so this keeps a block's record indexes in range
+static_assert(STORAGE_DATA_SIZE <= (1 << STORAGE_SEQUENCE_SHIFT), "too many records per block");
+
+#define STORAGE_SNAPSHOT_RETRIES 8
+
 typedef struct storage_buffer_t {
     storage_block_t block;
     uint16_t index;
@@ -40,9 +46,50 @@ typedef struct storage_ctx_t {
     uint32_t read_block_index;  // next block to read
     uint32_t write_block_index; // next block to be written
     uint32_t write_counter;
+    uint32_t boot_counter;      // write counter when opened, the first block of this boot
+    atomic_uint_least32_t lock; // odd while the writer changes its position or write buffer
 } storage_ctx_t;
 
-static storage_ctx_t storage_ctx = {0};
+#define STORAGE_HANDLE_COUNT 2 // rings open at once, each on its own device
+
+static storage_ctx_t storage_ctx[STORAGE_HANDLE_COUNT] = {0};
+
+/*
+ * Forward reader over the whole ring for queries made from other tasks. It has its own block
+ * buffer so it never disturbs the logger's read and write buffers. Blocks are visited in the
+ * order they were written: block 0 from the first pass, then from the next block to be
+ * overwritten round to the last one written, and finally whatever is still in the write buffer.
+ * Blocks that fail their checks, or carry a counter the writer has not reached, are skipped.
+ *
+ * The logger runs on another task, so the cursor takes a snapshot of the write counter and
+ * block index when it opens, under a sequence lock the writer holds only while it moves its
+ * position or appends to the write buffer, never across a flash write. Blocks written after the
+ * snapshot are left for the next query. The write buffer is copied under the same lock, and
+ * only if it has not been flushed since the snapshot, so every record a query returns is at
+ * its final sequence number and none after it has been passed over.
+ *
+ * Every record has a sequence number made from its block's counter and its index in the block.
+ * The write buffer is given the counter it will be written with, so numbers do not change when
+ * it is flushed. Blocks are written in counter order, so the block holding a sequence number is
+ * found by arithmetic and a seek reads only the blocks from there on.
+ */
+typedef struct storage_cursor_ctx_t {
+    storage_handle_t handle;
+    storage_buffer_t buffer;
+    uint16_t used;          // bytes of string data in the buffer
+    uint32_t counter;       // of the block in the buffer
+    uint16_t record;        // index in the block of the next record
+    uint64_t sequence;      // of the record last returned
+    uint32_t write_counter; // snapshot at open, later blocks are not visited
+    uint32_t block_counter; // of the next block for storage_cursor_block()
+    uint32_t block_index;   // next block to load
+    uint32_t blocks_left;   // blocks still to visit after block 0
+    bool first_block;       // block 0 not visited yet
+    bool write_buffer;      // the write buffer not visited yet
+    bool open;
+} storage_cursor_ctx_t;
+
+static storage_cursor_ctx_t storage_cursor_ctx[STORAGE_HANDLE_COUNT] = {0}; // one per ring
 
 static uint16_t storage_crc16(uint8_t buffer[], uint16_t size) {
     uint16_t crc = 0xFFFF;
@@ -58,24 +105,39 @@ static uint16_t storage_crc16(uint8_t buffer[], uint16_t size) {
     return crc;
 }
 
+/* Open and close the window in which cursors must not copy the writer's state */
+static void storage_write_begin(storage_handle_t handle) {
+    uint32_t lock = atomic_load_explicit(&handle->lock, memory_order_relaxed);
+    atomic_store_explicit(&handle->lock, lock + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void storage_write_end(storage_handle_t handle) {
+    uint32_t lock = atomic_load_explicit(&handle->lock, memory_order_relaxed);
+    atomic_store_explicit(&handle->lock, lock + 1, memory_order_release);
+}
+
 static nvm_err_t storage_write_block(storage_handle_t handle) {
     nvm_err_t error = NVM_OK;
     if (handle->write_buffer.index != 0) {
         handle->write_buffer.block.header.magic = STORAGE_MAGIC;
-        handle->write_buffer.block.header.counter = handle->write_counter++;
+        handle->write_buffer.block.header.counter = handle->write_counter;
         handle->write_buffer.block.header.crc =
             storage_crc16(handle->write_buffer.block.data, STORAGE_DATA_SIZE);
-        if (handle->write_block_index >= handle->device->sector_count) {
-            handle->write_block_index = 1; // wrap to beginning of media
+        uint32_t block_index = handle->write_block_index;
+        if (block_index >= handle->device->sector_count) {
+            block_index = 1; // wrap to beginning of media
         }
-        if (handle->device->read(handle->write_block_index,
-                                 (uint8_t *)&handle->cache_buffer.block) != NVM_ERASED) {
-            error = handle->device->erase(handle->write_block_index, 1);
+        if (handle->device->read(block_index, (uint8_t *)&handle->cache_buffer.block) !=
+            NVM_ERASED) {
+            error = handle->device->erase(block_index, 1);
         }
-        error = handle->device->write(handle->write_block_index,
-                                      (uint8_t *)&handle->write_buffer.block);
+        error = handle->device->write(block_index, (uint8_t *)&handle->write_buffer.block);
+        storage_write_begin(handle);
+        handle->write_counter++;
         memset(&handle->write_buffer, 0, sizeof(handle->write_buffer));
-        handle->write_block_index += 1;
+        handle->write_block_index = block_index + 1;
+        storage_write_end(handle);
     } else {
         LOG_ERROR(TAG, "nothing to write");
     }
@@ -103,58 +165,85 @@ static nvm_err_t storage_read_block(storage_handle_t handle) {
     return error;
 }
 
+/* Read a block's counter, false if the block is erased or fails its checks */
+static bool storage_block_counter(storage_handle_t handle, uint32_t block_index,
+                                  uint32_t *counter) {
+    storage_block_t *block = &handle->cache_buffer.block;
+    if ((handle->device->read(block_index, (uint8_t *)block) != NVM_OK) ||
+        (block->header.magic != STORAGE_MAGIC) ||
+        (block->header.crc != storage_crc16(block->data, STORAGE_DATA_SIZE))) {
+        return false;
+    }
+    *counter = block->header.counter;
+    return true;
+}
+
+/*
+ * Carry on from the newest block, so counters and sequence numbers keep rising across boots.
+ * Block 0 is written once after a format, then blocks 1 and up are a ring whose counters rise
+ * from block 1 to the newest block, with only older or erased blocks after it. A binary search
+ * for the last block at least as new as block 1 finds it in log2 of the block count reads.
+ */
+static void storage_recover(storage_handle_t handle) {
+    uint32_t sector_count = handle->device->sector_count;
+    uint32_t first;
+    uint32_t counter;
+    handle->write_counter = 0;
+    handle->write_block_index = 0;
+    if (!storage_block_counter(handle, 0, &counter)) {
+        return; // blank media, start from block 0
+    }
+    handle->write_counter = counter + 1;
+    handle->write_block_index = 1;
+    if ((sector_count < 2) || !storage_block_counter(handle, 1, &first) || (first <= counter)) {
+        return; // only block 0 written
+    }
+    uint32_t low = 1;             // at least as new as block 1
+    uint32_t high = sector_count; // older, erased or past the end
+    while (high - low > 1) {
+        uint32_t middle = low + (high - low) / 2;
+        if (storage_block_counter(handle, middle, &counter) && (counter >= first)) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    storage_block_counter(handle, low, &counter);
+    handle->write_counter = counter + 1;
+    handle->write_block_index = low + 1;
+}
+
 nvm_err_t storage_open(storage_handle_t *handle, nvm_device_t *device) {
-    nvm_err_t error = NVM_OK;
-    *handle = &storage_ctx;
+    int slot = 0;
+    while ((slot < STORAGE_HANDLE_COUNT) && (storage_ctx[slot].device != NULL) &&
+           (storage_ctx[slot].device != device)) {
+        slot++;
+    }
+    if (slot == STORAGE_HANDLE_COUNT) {
+        LOG_ERROR(TAG, "too many rings");
+        return NVM_FULL;
+    }
+    *handle = &storage_ctx[slot];
     (*handle)->device = device;
     if((*handle)->device->open() != NVM_OK) {
         LOG_ERROR(TAG, "open failed");
         return NVM_FAIL;
     }
-    (*handle)->read_block_index = 0; // check if media is formatted by checking block 0
-    if (storage_read_block(*handle) != NVM_OK) {
-        // storage_format(*handle);
-    }
-    // uint32_t high_block_index = (*handle)->device->sector_count - 1;
-    // uint32_t low_block_index = 1; // binary search for the first unused block
-    // uint32_t counter = 0;
-    // (*handle)->read_block_index = low_block_index;
-    // if (storage_read_block(*handle) == NVM_OK) {
-    //     counter = (*handle)->read_buffer.block.header.counter;
-    // }
-    // while (low_block_index != high_block_index) {
-    //     uint32_t mid_block_index = low_block_index + (high_block_index - low_block_index) / 2;
-    //     (*handle)->read_block_index = mid_block_index;
-    //     error = storage_read_block(*handle);
-    //     if (error == NVM_OK) {
-    //         if (counter < (*handle)->read_buffer.block.header.counter) {
-    //             low_block_index = mid_block_index;
-    //         } else {
-    //             high_block_index = mid_block_index;
-    //         }
-    //         counter = (*handle)->read_buffer.block.header.counter;
-    //     } else {
-    //         high_block_index = mid_block_index; // must be first pass of formated media
-    //         if (error != NVM_ERASED) {
-    //             LOG_ERROR(TAG, "read block %d failed", (int)mid_block_index);
-    //         }
-    //     }
-    // }
-    // (*handle)->write_counter = (*handle)->read_buffer.block.header.counter + 1;
-    // if ((*handle)->write_counter == 0) {
-    //     low_block_index = 0;
-    // }
-    // (*handle)->read_block_index = low_block_index; // initialise read and write block indexes
-    // (*handle)->write_block_index = low_block_index + 1;
-    return error;
+    storage_recover(*handle);
+    (*handle)->boot_counter = (*handle)->write_counter;
+    LOG_DEBUG(TAG, "resuming at block %lu with counter %lu",
+             (unsigned long)(*handle)->write_block_index, (unsigned long)(*handle)->write_counter);
+    return NVM_OK;
 }
 
 nvm_err_t storage_format(storage_handle_t handle) {
     nvm_err_t error = NVM_OK;
     error = handle->device->erase(0, handle->device->sector_count);
     if (error == NVM_OK) {
+        storage_write_begin(handle);
         handle->write_block_index = 0;
         memset(&handle->write_buffer.block, 0, sizeof(handle->write_buffer.block));
+        storage_write_end(handle);
         storage_write_string(handle, "NVM STRING LOGGER");
         storage_write_sync(handle);
     } else {
@@ -227,8 +316,10 @@ nvm_err_t storage_write_string(storage_handle_t handle, const char *string) {
     if (handle->write_buffer.index + size > STORAGE_DATA_SIZE) {
         error = storage_write_block(handle);
     }
+    storage_write_begin(handle);
     memcpy(&handle->write_buffer.block.data[handle->write_buffer.index], string, size);
     handle->write_buffer.index += size;
+    storage_write_end(handle);
     return error;
 }
 
@@ -237,4 +328,235 @@ nvm_err_t storage_close(storage_handle_t handle) {
     error = storage_write_sync(handle);
     handle->device->close();
     return error;
-}
\ No newline at end of file
+}
+
+/* The oldest counter left in blocks 1 and up, block 0 is used on the first pass only */
+static uint32_t storage_oldest_counter(uint32_t sector_count, uint32_t write_counter) {
+    return write_counter > sector_count ? write_counter - (sector_count - 1) : 0;
+}
+
+/* The block a counter was written to */
+static uint32_t storage_counter_block(uint32_t sector_count, uint32_t counter) {
+    return counter < sector_count ? counter : 1 + (counter - sector_count) % (sector_count - 1);
+}
+
+/*
+ * Copy the writer's counter and block index, and the used part of the write buffer if data is
+ * given, as they were at one instant. False if the writer was busy on every attempt.
+ */
+static bool storage_snapshot(storage_handle_t handle, uint32_t *write_counter,
+                             uint32_t *write_block_index, uint8_t *data, uint16_t *used) {
+    for (int attempt = 0; attempt < STORAGE_SNAPSHOT_RETRIES; attempt++) {
+        uint32_t before = atomic_load_explicit(&handle->lock, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        *write_counter = handle->write_counter;
+        *write_block_index = handle->write_block_index;
+        if (data) {
+            *used = handle->write_buffer.index;
+            memcpy(data, handle->write_buffer.block.data, *used <= STORAGE_DATA_SIZE ? *used : 0);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&handle->lock, memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+nvm_err_t storage_cursor_open(storage_handle_t handle, storage_cursor_t *cursor) {
+    storage_cursor_ctx_t *ctx = &storage_cursor_ctx[handle - storage_ctx];
+    if (ctx->open) {
+        return NVM_FULL; // only one query at a time on each ring
+    }
+    uint32_t write_counter;
+    uint32_t write_block_index;
+    if (!storage_snapshot(handle, &write_counter, &write_block_index, NULL, NULL)) {
+        return NVM_FULL;
+    }
+    *cursor = ctx;
+    (*cursor)->handle = handle;
+    (*cursor)->used = 0;
+    (*cursor)->buffer.index = 0;
+    (*cursor)->write_counter = write_counter;
+    (*cursor)->block_counter = 0;
+    (*cursor)->first_block = write_block_index != 0;
+    (*cursor)->block_index = write_block_index < 1 ? 1 : write_block_index;
+    (*cursor)->blocks_left = handle->device->sector_count - 1;
+    (*cursor)->write_buffer = true;
+    (*cursor)->open = true;
+    return NVM_OK;
+}
+
+/* Index of the next block in write order, false once every block has been visited */
+static bool storage_cursor_step(storage_cursor_t cursor, uint32_t *block_index) {
+    if (cursor->first_block) {
+        cursor->first_block = false;
+        *block_index = 0;
+    } else if (cursor->blocks_left) {
+        cursor->blocks_left--;
+        if (cursor->block_index >= cursor->handle->device->sector_count) {
+            cursor->block_index = 1; // wrap to beginning of media
+        }
+        *block_index = cursor->block_index++;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool storage_block_valid(storage_cursor_t cursor, const storage_block_t *block) {
+    return (block->header.magic == STORAGE_MAGIC) &&
+           (block->header.counter < cursor->write_counter) &&
+           (block->header.crc == storage_crc16((uint8_t *)block->data, STORAGE_DATA_SIZE));
+}
+
+/* Load the next block in write order, NVM_EMPTY once the write buffer has been loaded */
+static nvm_err_t storage_cursor_load(storage_cursor_t cursor) {
+    storage_handle_t handle = cursor->handle;
+    uint32_t block_index;
+    if (!storage_cursor_step(cursor, &block_index)) {
+        if (!cursor->write_buffer) {
+            return NVM_EMPTY;
+        }
+        cursor->write_buffer = false;
+        uint32_t write_counter;
+        uint32_t write_block_index;
+        uint16_t used;
+        if (!storage_snapshot(handle, &write_counter, &write_block_index, cursor->buffer.block.data,
+                              &used) ||
+            (write_counter != cursor->write_counter)) {
+            return NVM_EMPTY; // flushed since the snapshot, the next query reads it from flash
+        }
+        cursor->used = used;
+        cursor->buffer.index = 0;
+        cursor->counter = write_counter;
+        cursor->record = 0;
+        return NVM_OK;
+    }
+    cursor->used = 0;
+    cursor->buffer.index = 0;
+    cursor->record = 0;
+    if ((handle->device->read(block_index, (uint8_t *)&cursor->buffer.block) == NVM_OK) &&
+        storage_block_valid(cursor, &cursor->buffer.block)) {
+        cursor->counter = cursor->buffer.block.header.counter;
+        uint16_t used = STORAGE_DATA_SIZE;
+        while ((used != 0) && (cursor->buffer.block.data[used - 1] == '\0')) {
+            used -= 1; // trim the unused tail of the block
+        }
+        cursor->used = used ? used + 1 : 0; // keep the last null terminator
+    }
+    return NVM_OK;
+}
+
+/*
+ * Start from the block holding sequence, so the records that follow are all those from there
+ * on. If the block has already been overwritten the cursor starts at the oldest block of the
+ * ring, passing over block 0 unless that holds the sequence, and NVM_FAIL says that records
+ * were lost. A sequence number ahead of the ring, handed out before a format, fails the same
+ * way with the cursor left at the start.
+ */
+nvm_err_t storage_cursor_seek(storage_cursor_t cursor, uint64_t sequence) {
+    storage_handle_t handle = cursor->handle;
+    uint32_t sector_count = handle->device->sector_count;
+    uint64_t counter = sequence >> STORAGE_SEQUENCE_SHIFT;
+    uint32_t write_counter = cursor->write_counter;
+    cursor->used = 0;
+    cursor->buffer.index = 0;
+    if (counter > write_counter) {
+        return NVM_FAIL;
+    }
+    if (counter == write_counter) {
+        cursor->first_block = false; // only the write buffer can hold it
+        cursor->blocks_left = 0;
+        return NVM_OK;
+    }
+    if (counter < storage_oldest_counter(sector_count, write_counter)) {
+        cursor->first_block = counter == 0; // block 0 is older still
+        return NVM_FAIL;
+    }
+    cursor->first_block = false;
+    cursor->block_index = storage_counter_block(sector_count, (uint32_t)counter);
+    cursor->blocks_left = write_counter - counter;
+    return NVM_OK;
+}
+
+/* Point string at the next record in write order, valid until the next call */
+nvm_err_t storage_cursor_next(storage_cursor_t cursor, const char **string) {
+    while (cursor->buffer.index >= cursor->used) {
+        nvm_err_t error = storage_cursor_load(cursor);
+        if (error != NVM_OK) {
+            return error;
+        }
+    }
+    *string = (const char *)&cursor->buffer.block.data[cursor->buffer.index];
+    cursor->buffer.index += strnlen(*string, cursor->used - cursor->buffer.index) + 1;
+    cursor->sequence = ((uint64_t)cursor->counter << STORAGE_SEQUENCE_SHIFT) | cursor->record++;
+    return NVM_OK;
+}
+
+uint64_t storage_cursor_sequence(storage_cursor_t cursor) {
+    return cursor->sequence;
+}
+
+/*
+ * Copy the next block of the ring into the cursor buffer and point block at it, header included.
+ * Blocks come in write order, from the oldest still kept up to the last one written before the
+ * cursor opened, so there are always storage_cursor_blocks() of them. The copy is checked, not
+ * the flash, so a block the logger overwrites or is part way through erasing while it is read
+ * cannot get past; it comes back zeroed, which fails any reader's magic check, with NVM_FAIL.
+ * The pointer is valid until the next call. The write buffer is not included. Do not mix with
+ * storage_cursor_next() on the same cursor.
+ */
+nvm_err_t storage_cursor_block(storage_cursor_t cursor, const uint8_t **block) {
+    storage_handle_t handle = cursor->handle;
+    uint32_t sector_count = handle->device->sector_count;
+    uint32_t counter = cursor->block_counter;
+    if (counter >= cursor->write_counter) {
+        return NVM_EMPTY;
+    }
+    uint32_t oldest = storage_oldest_counter(sector_count, cursor->write_counter);
+    cursor->block_counter = (counter == 0) && (oldest > 1) ? oldest : counter + 1;
+    uint32_t block_index = storage_counter_block(sector_count, counter);
+    const uint8_t *base = NULL;
+    nvm_err_t error = NVM_OK;
+    if (handle->device->map && (handle->device->map(&base) == NVM_OK)) {
+        memcpy(&cursor->buffer.block, &base[block_index * handle->device->sector_size],
+               sizeof(cursor->buffer.block));
+    } else {
+        error = handle->device->read(block_index, (uint8_t *)&cursor->buffer.block);
+    }
+    *block = (const uint8_t *)&cursor->buffer.block;
+    if ((error != NVM_OK) || (cursor->buffer.block.header.counter != counter) ||
+        !storage_block_valid(cursor, &cursor->buffer.block)) {
+        memset(&cursor->buffer.block, 0, sizeof(cursor->buffer.block));
+        return NVM_FAIL;
+    }
+    return NVM_OK;
+}
+
+/* The sequence number of the first record written since the ring was opened at boot */
+uint64_t storage_boot_sequence(storage_handle_t handle) {
+    return (uint64_t)handle->boot_counter << STORAGE_SEQUENCE_SHIFT;
+}
+
+/* Blocks storage_cursor_block() hands out: block 0 from the first pass and the rest of the ring */
+uint32_t storage_cursor_blocks(storage_cursor_t cursor) {
+    uint32_t sector_count = cursor->handle->device->sector_count;
+    return cursor->write_counter < sector_count ? cursor->write_counter : sector_count;
+}
+
+/* The number of blocks written when the cursor opened, so it identifies what the cursor sees */
+uint32_t storage_cursor_head(storage_cursor_t cursor) {
+    return cursor->write_counter;
+}
+
+size_t storage_block_size(void) {
+    return STORAGE_BLOCK_SIZE;
+}
+
+nvm_err_t storage_cursor_close(storage_cursor_t cursor) {
+    cursor->open = false;
+    return NVM_OK;
+}
@@ -14,6 +14,12 @@ extern "C" {
 typedef struct storage_ctx_t storage_ctx_t;
 typedef storage_ctx_t *storage_handle_t;
 
+// a record's sequence number is its block counter followed by its index within the block
+#define STORAGE_SEQUENCE_SHIFT 8
+
+typedef struct storage_cursor_ctx_t storage_cursor_ctx_t;
+typedef storage_cursor_ctx_t *storage_cursor_t;
+
 nvm_err_t storage_open(storage_handle_t *handle, nvm_device_t *device);
 nvm_err_t storage_read_sync(storage_handle_t handle);
 nvm_err_t storage_read_string(storage_handle_t handle, char *string, size_t maxlen);
@@ -21,6 +27,16 @@ nvm_err_t storage_write_sync(storage_handle_t handle);
 nvm_err_t storage_write_string(storage_handle_t handle, const char *string);
 nvm_err_t storage_format(storage_handle_t handle);
 nvm_err_t storage_close(storage_handle_t handle);
+nvm_err_t storage_cursor_open(storage_handle_t handle, storage_cursor_t *cursor);
+nvm_err_t storage_cursor_seek(storage_cursor_t cursor, uint64_t sequence);
+nvm_err_t storage_cursor_next(storage_cursor_t cursor, const char **string);
+uint64_t storage_cursor_sequence(storage_cursor_t cursor);
+nvm_err_t storage_cursor_block(storage_cursor_t cursor, const uint8_t **block);
+uint64_t storage_boot_sequence(storage_handle_t handle);
+uint32_t storage_cursor_blocks(storage_cursor_t cursor);
+uint32_t storage_cursor_head(storage_cursor_t cursor);
+nvm_err_t storage_cursor_close(storage_cursor_t cursor);
+size_t storage_block_size(void);
 
 #ifdef __cplusplus
 } // extern "C"
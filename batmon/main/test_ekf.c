@@ -0,0 +1,100 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "aggregate.h"
+#include "ekf.h"
+
+/*
+ * Replays a synthetic drive cycle through the estimator. The trace is generated from the same
+ * battery model with a different initial state of charge, a current sensor offset and noisy
+ * voltage frames, so the filter has to converge and then track.
+ */
+
+#define TEST_FRAME_PERIOD_US 50000 // current and voltage frames interleaved at 10 Hz each
+#define TEST_DURATION_S (4 * 3600)
+#define TEST_TRUE_INITIAL_SOC 0.9f
+#define TEST_CURRENT_OFFSET_A 0.2f
+#define TEST_SETTLE_S 1800 // error statistics exclude the initial convergence
+#define TEST_MAX_RMS_ERROR 0.05f
+
+static float test_noise(float amplitude) { return amplitude * ((rand() / (float)RAND_MAX) * 2 - 1); }
+
+/* Current profile: discharge, rest, charge, rest, repeated */
+static float test_current(int64_t t_s) {
+    switch ((t_s / 1200) % 4) {
+        case 0:
+            return -25.0f + test_noise(3.0f);
+        case 2:
+            return 20.0f + test_noise(1.0f);
+        default:
+            return 0.5f * sinf(t_s * 0.1f);
+    }
+}
+
+static double test_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    srand(1);
+    aggregate_init();
+    ekf_init(NULL);
+
+    const float capacity_ah = 100.0f, r0 = 0.010f, r1 = 0.005f, tau = 30.0f;
+    float soc = TEST_TRUE_INITIAL_SOC;
+    float vrc = 0;
+    float current = 0;
+    double error_sum = 0;
+    float error_max = 0;
+    uint32_t error_count = 0;
+    uint32_t updates = 0;
+    double filter_time = 0;
+
+    for (int64_t t_us = 0; t_us < TEST_DURATION_S * 1000000LL; t_us += TEST_FRAME_PERIOD_US) {
+        float dt = TEST_FRAME_PERIOD_US * 1e-6f;
+        float decay = expf(-dt / tau);
+        soc += (current > 0 ? 0.98f : 1.0f) * current * dt / (3600.0f * capacity_ah);
+        vrc = vrc * decay + r1 * (1.0f - decay) * current;
+
+        uint8_t device_id;
+        int16_t value;
+        if ((t_us / TEST_FRAME_PERIOD_US) & 1) {
+            float voltage = ekf_ocv(soc) + vrc + r0 * current + test_noise(0.02f);
+            device_id = 2;
+            value = lrintf(voltage * 1000.0f);
+        } else {
+            current = test_current(t_us / 1000000);
+            device_id = 1;
+            value = lrintf((current + TEST_CURRENT_OFFSET_A) * 1000.0f);
+        }
+
+        double start = test_seconds();
+        ekf_add(device_id, value, t_us);
+        filter_time += test_seconds() - start;
+        updates++;
+
+        if (t_us >= TEST_SETTLE_S * 1000000LL) {
+            ekf_result_t result;
+            ekf_get(&result);
+            float error = fabsf(result.soc_permille * 0.001f - soc);
+            error_sum += error * error;
+            error_max = error > error_max ? error : error_max;
+            error_count++;
+        }
+    }
+
+    float rms = sqrt(error_sum / error_count);
+    ekf_result_t result;
+    ekf_get(&result);
+    printf("final soc %.3f, estimate %.3f +/- %.3f\n", soc, result.soc_permille * 0.001f,
+           result.soc_stddev_permille * 0.001f);
+    printf("error after %d s: rms %.4f, max %.4f\n", TEST_SETTLE_S, rms, error_max);
+    printf("%.1f ns per update over %lu updates\n", filter_time / updates * 1e9,
+           (unsigned long)updates);
+    return rms < TEST_MAX_RMS_ERROR ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,164 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spsc.h"
+
+/*
+ * Two thread test and benchmark of the SPSC ring. The producer sends a sequence of items and
+ * the consumer checks none are lost, duplicated or reordered. The same traffic is then sent
+ * through a mutex protected queue that copies by value, standing in for xQueueSend() and
+ * xQueueReceive(), which take a critical section for every item. A side that finds the ring
+ * full or empty yields, so the test also runs sensibly on a single core.
+ */
+
+#define TEST_ITEMS (1 << 22)
+#define TEST_RING_SIZE 256
+#define TEST_BATCH 16
+
+typedef struct test_item_t {
+    uint32_t sequence;
+    uint32_t payload[3]; // about the size of a tinbus_msg_t
+} test_item_t;
+
+SPSC_DEFINE(test_ring, test_item_t, TEST_RING_SIZE);
+
+typedef struct test_queue_t {
+    pthread_mutex_t lock;
+    test_item_t items[TEST_RING_SIZE];
+    uint32_t head;
+    uint32_t tail;
+} test_queue_t;
+
+static test_queue_t test_queue = {.lock = PTHREAD_MUTEX_INITIALIZER};
+static int test_batched = 0;
+
+static double test_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *test_spsc_producer(void *arg) {
+    uint32_t sequence = 0;
+    while (sequence < TEST_ITEMS) {
+        if (test_batched) {
+            void *slots;
+            uint32_t count = spsc_reserve(&test_ring, &slots, TEST_BATCH);
+            test_item_t *items = slots;
+            for (uint32_t i = 0; (i < count) && (sequence < TEST_ITEMS); i++) {
+                items[i].sequence = sequence++;
+                items[i].payload[0] = items[i].sequence * 3;
+            }
+            spsc_commit(&test_ring, count);
+            if (count == 0) {
+                sched_yield();
+            }
+        } else {
+            test_item_t item = {.sequence = sequence, .payload = {sequence * 3}};
+            if (spsc_push(&test_ring, &item)) {
+                sequence++;
+            } else {
+                sched_yield();
+            }
+        }
+    }
+    return NULL;
+}
+
+static uint32_t test_spsc_consumer(void) {
+    uint32_t errors = 0;
+    uint32_t expected = 0;
+    while (expected < TEST_ITEMS) {
+        if (test_batched) {
+            void *slots;
+            uint32_t count = spsc_peek(&test_ring, &slots, TEST_BATCH);
+            test_item_t *items = slots;
+            for (uint32_t i = 0; i < count; i++, expected++) {
+                errors += (items[i].sequence != expected) || (items[i].payload[0] != expected * 3);
+            }
+            spsc_release(&test_ring, count);
+            if (count == 0) {
+                sched_yield();
+            }
+        } else {
+            test_item_t item;
+            if (spsc_pop(&test_ring, &item)) {
+                errors += (item.sequence != expected) || (item.payload[0] != expected * 3);
+                expected++;
+            } else {
+                sched_yield();
+            }
+        }
+    }
+    return errors;
+}
+
+static void *test_queue_producer(void *arg) {
+    uint32_t sequence = 0;
+    while (sequence < TEST_ITEMS) {
+        test_item_t item = {.sequence = sequence, .payload = {sequence * 3}};
+        bool sent = false;
+        pthread_mutex_lock(&test_queue.lock);
+        if (test_queue.head - test_queue.tail < TEST_RING_SIZE) {
+            memcpy(&test_queue.items[test_queue.head % TEST_RING_SIZE], &item, sizeof(item));
+            test_queue.head++;
+            sequence++;
+            sent = true;
+        }
+        pthread_mutex_unlock(&test_queue.lock);
+        if (!sent) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static uint32_t test_queue_consumer(void) {
+    uint32_t errors = 0;
+    uint32_t expected = 0;
+    while (expected < TEST_ITEMS) {
+        test_item_t item;
+        bool received = false;
+        pthread_mutex_lock(&test_queue.lock);
+        if (test_queue.head != test_queue.tail) {
+            memcpy(&item, &test_queue.items[test_queue.tail % TEST_RING_SIZE], sizeof(item));
+            test_queue.tail++;
+            received = true;
+        }
+        pthread_mutex_unlock(&test_queue.lock);
+        if (received) {
+            errors += item.sequence != expected;
+            expected++;
+        } else {
+            sched_yield();
+        }
+    }
+    return errors;
+}
+
+static uint32_t test_run(const char *name, void *(*producer)(void *), uint32_t (*consumer)(void)) {
+    pthread_t thread;
+    double start = test_seconds();
+    pthread_create(&thread, NULL, producer, NULL);
+    uint32_t errors = consumer();
+    pthread_join(thread, NULL);
+    double elapsed = test_seconds() - start;
+    printf("%-22s: %7.2f Mitems/s, %lu errors\n", name, TEST_ITEMS / elapsed * 1e-6,
+           (unsigned long)errors);
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    uint32_t errors = 0;
+    test_batched = 0;
+    errors += test_run("spsc push / pop", test_spsc_producer, test_spsc_consumer);
+    test_batched = 1;
+    errors += test_run("spsc reserve / commit", test_spsc_producer, test_spsc_consumer);
+    errors += test_run("mutex queue", test_queue_producer, test_queue_consumer);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -2,12 +2,13 @@
 #include "driver/rmt_rx.h"
 #include "driver/rmt_tx.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
 #include "freertos/task.h"
 
 #include "hardware.h"
 #include "mb_crc.h"
+#include "spsc.h"
 #include "tinbus.h"
 
 #define TINBUS_RESOLUTION_HZ 1000000 // 1 MHz resolution, 1 tick = 10 us
@@ -21,13 +22,19 @@
 typedef struct tinbus_rx_data_t {
     rmt_symbol_word_t symbols[TINBUS_RMT_MEM_BLOCK_SYMBOLS];
     size_t size;
+    int64_t timestamp_us;
 } tinbus_rx_data_t;
 
 static const char *TAG = "tinbus";
 
 static rmt_channel_handle_t rx_channel = NULL;
-static tinbus_rx_data_t tinbus_rx_data;
-static QueueHandle_t rx_queue = NULL;
+
+// the RMT driver receives straight into a reserved ring slot, which is committed to the parser
+// when the frame is complete; if the parser has fallen behind the frame lands in the overflow
+// slot and is dropped
+SPSC_DEFINE(tinbus_rx_ring, tinbus_rx_data_t, TINBUS_RX_QUEUE_SIZE);
+static tinbus_rx_data_t tinbus_rx_overflow;
+static tinbus_rx_data_t *tinbus_rx_slot = &tinbus_rx_overflow;
 
 static rmt_receive_config_t receive_config = {
     .signal_range_min_ns = 3000,   // < 3 us signal will be treated as noise (hardware limit is 1000 * 255 / 80)
@@ -70,6 +77,7 @@ static esp_err_t tinbus_parse_frame(const tinbus_rx_data_t *rx_data, tinbus_msg_
         }
     }
     if (mb_crc_is_ok(buffer, TINBUS_FRAME_SIZE)) {
+        msg->timestamp_us = rx_data->timestamp_us;
         msg->device_id = buffer[0];
         msg->value = ((uint16_t)buffer[1] << 8) | (uint16_t)buffer[2];
         return ESP_OK;
@@ -77,18 +85,26 @@ static esp_err_t tinbus_parse_frame(const tinbus_rx_data_t *rx_data, tinbus_msg_
     return ESP_FAIL;
 }
 
+static esp_err_t IRAM_ATTR tinbus_rx_start(void) {
+    void *slot;
+    tinbus_rx_slot = spsc_reserve(&tinbus_rx_ring, &slot, 1) ? slot : &tinbus_rx_overflow;
+    return rmt_receive(rx_channel, tinbus_rx_slot->symbols, sizeof(tinbus_rx_slot->symbols), &receive_config);
+}
+
 static bool IRAM_ATTR tinbus_rmt_rx_done_callback(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *edata,
                                                   void *user_data) {
-    BaseType_t high_task_wakeup = pdFALSE;
-    QueueHandle_t queue = (QueueHandle_t)user_data;
-    if (tinbus_rx_data.symbols == edata->received_symbols) {
-        tinbus_rx_data.size = edata->num_symbols;
-        // place rx data in queue ready for parser to process
-        xQueueSendFromISR(queue, &tinbus_rx_data, &high_task_wakeup);
+    if (tinbus_rx_slot->symbols == edata->received_symbols) {
+        tinbus_rx_slot->size = edata->num_symbols;
+        // stamp the frame at the end of reception, before any queueing delay
+        tinbus_rx_slot->timestamp_us = esp_timer_get_time();
+        // publish the slot ready for parser to process
+        if (tinbus_rx_slot != &tinbus_rx_overflow) {
+            spsc_commit(&tinbus_rx_ring, 1);
+        }
     }
-    // restart the receiver
-    rmt_receive(rx_channel, tinbus_rx_data.symbols, sizeof(tinbus_rx_data.symbols), &receive_config);
-    return high_task_wakeup == pdTRUE;
+    // restart the receiver, the parser polls so no task needs waking
+    tinbus_rx_start();
+    return false;
 }
 
 esp_err_t tinbus_init(void) {
@@ -105,22 +121,22 @@ esp_err_t tinbus_init(void) {
     ESP_ERROR_CHECK(rmt_new_rx_channel(&rx_channel_cfg, &rx_channel));
 
     ESP_LOGI(TAG, "register RX done callback");
-    rx_queue = xQueueCreate(TINBUS_RX_QUEUE_SIZE, sizeof(tinbus_rx_data_t));
-    assert(rx_queue);
-
     rmt_rx_event_callbacks_t cbs = {
         .on_recv_done = tinbus_rmt_rx_done_callback,
     };
-    ESP_ERROR_CHECK(rmt_rx_register_event_callbacks(rx_channel, &cbs, rx_queue));
+    ESP_ERROR_CHECK(rmt_rx_register_event_callbacks(rx_channel, &cbs, NULL));
     ESP_ERROR_CHECK(rmt_enable(rx_channel));
-    ESP_ERROR_CHECK(rmt_receive(rx_channel, tinbus_rx_data.symbols, sizeof(tinbus_rx_data.symbols), &receive_config));
+    ESP_ERROR_CHECK(tinbus_rx_start());
     return ESP_OK;
 }
 
 esp_err_t tinbus_read(tinbus_msg_t *msg) {
-    tinbus_rx_data_t rx_data;
-    if (xQueueReceive(rx_queue, &rx_data, 0) == pdPASS) {
-        return tinbus_parse_frame(&rx_data, msg);
+    void *slot;
+    if (spsc_peek(&tinbus_rx_ring, &slot, 1)) {
+        // parse in place then hand the slot back to the receiver
+        esp_err_t err = tinbus_parse_frame(slot, msg);
+        spsc_release(&tinbus_rx_ring, 1);
+        return err;
     }
     return ESP_FAIL;
 }
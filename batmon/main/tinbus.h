@@ -9,6 +9,7 @@ extern "C" {
 #endif
 
 typedef struct tinbus_msg_t {
+    int64_t timestamp_us; // esp_timer time at which the frame was received
     uint8_t device_id;
     int16_t value;
 } tinbus_msg_t;
@@ -0,0 +1,163 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "aggregate.h"
+#include "registry.h"
+#include "window.h"
+
+/*
+ * Each window is a ring of buckets built from the one second aggregate periods. Long windows use
+ * coarser buckets so that no window needs more than WINDOW_SLOTS_MAX of them. The sum and count
+ * over the ring are kept as running totals, and min / max come from monotonic deques of bucket
+ * extremes, so each update and query is O(1) amortised regardless of the window length.
+ */
+
+#define WINDOW_SLOTS_MAX 60
+
+typedef struct window_span_config_t {
+    uint16_t slots;
+    uint16_t periods_per_slot;
+} window_span_config_t;
+
+static const window_span_config_t window_span_config[WINDOW_COUNT] = {
+    [WINDOW_1S] = {.slots = 1, .periods_per_slot = 1},
+    [WINDOW_10S] = {.slots = 10, .periods_per_slot = 1},
+    [WINDOW_1M] = {.slots = 60, .periods_per_slot = 1},
+    [WINDOW_15M] = {.slots = 60, .periods_per_slot = 15},
+    [WINDOW_1H] = {.slots = 60, .periods_per_slot = 60},
+};
+
+typedef struct window_bucket_t {
+    int64_t sum;
+    uint32_t count;
+} window_bucket_t;
+
+typedef struct window_extreme_t {
+    uint32_t sequence;
+    int16_t value;
+} window_extreme_t;
+
+typedef struct window_deque_t {
+    window_extreme_t entries[WINDOW_SLOTS_MAX];
+    uint8_t head;
+    uint8_t size;
+} window_deque_t;
+
+typedef struct window_t {
+    window_bucket_t ring[WINDOW_SLOTS_MAX];
+    int64_t sum; // totals over the completed buckets in the ring
+    uint32_t count;
+    uint32_t sequence; // number of buckets completed so far
+    window_bucket_t partial;
+    int16_t partial_min;
+    int16_t partial_max;
+    uint16_t partial_periods;
+    window_deque_t min;
+    window_deque_t max;
+} window_t;
+
+static window_t window_state[REGISTRY_CHANNEL_COUNT][WINDOW_COUNT];
+
+static inline window_extreme_t *window_deque_at(window_deque_t *deque, uint8_t offset) {
+    return &deque->entries[(deque->head + offset) % WINDOW_SLOTS_MAX];
+}
+
+/* Drop entries that have slid out of the window */
+static void window_deque_expire(window_deque_t *deque, uint32_t oldest_sequence) {
+    while ((deque->size > 0) && (window_deque_at(deque, 0)->sequence < oldest_sequence)) {
+        deque->head = (deque->head + 1) % WINDOW_SLOTS_MAX;
+        deque->size--;
+    }
+}
+
+/* Append a value, discarding older entries it dominates; sign is +1 for min and -1 for max */
+static void window_deque_push(window_deque_t *deque, uint32_t sequence, int16_t value, int sign) {
+    while ((deque->size > 0) &&
+           (sign * window_deque_at(deque, deque->size - 1)->value >= sign * value)) {
+        deque->size--;
+    }
+    window_extreme_t *entry = window_deque_at(deque, deque->size);
+    entry->sequence = sequence;
+    entry->value = value;
+    deque->size++;
+}
+
+static void window_reset_partial(window_t *window) {
+    memset(&window->partial, 0, sizeof(window->partial));
+    window->partial_min = INT16_MAX;
+    window->partial_max = INT16_MIN;
+    window->partial_periods = 0;
+}
+
+static void window_push(window_t *window, const window_span_config_t *config) {
+    window_bucket_t *slot = &window->ring[window->sequence % config->slots];
+    window->sum += window->partial.sum - slot->sum;
+    window->count += window->partial.count - slot->count;
+    *slot = window->partial;
+
+    uint32_t oldest_sequence =
+        window->sequence >= config->slots ? window->sequence + 1 - config->slots : 0;
+    window_deque_expire(&window->min, oldest_sequence);
+    window_deque_expire(&window->max, oldest_sequence);
+    if (window->partial.count > 0) {
+        window_deque_push(&window->min, window->sequence, window->partial_min, 1);
+        window_deque_push(&window->max, window->sequence, window->partial_max, -1);
+    }
+    window->sequence++;
+    window_reset_partial(window);
+}
+
+void window_init(void) {
+    memset(window_state, 0, sizeof(window_state));
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        for (uint8_t span = 0; span < WINDOW_COUNT; span++) {
+            window_reset_partial(&window_state[channel][span]);
+        }
+    }
+}
+
+/* Feed one aggregate period, call once per aggregate_flush() */
+void window_update(const aggregate_result_t results[REGISTRY_CHANNEL_COUNT]) {
+    for (uint8_t channel = 0; channel < REGISTRY_CHANNEL_COUNT; channel++) {
+        const aggregate_result_t *result = &results[channel];
+        for (uint8_t span = 0; span < WINDOW_COUNT; span++) {
+            window_t *window = &window_state[channel][span];
+            const window_span_config_t *config = &window_span_config[span];
+            window->partial.sum += result->sum;
+            window->partial.count += result->count;
+            if (result->count > 0) {
+                window->partial_min =
+                    result->min < window->partial_min ? result->min : window->partial_min;
+                window->partial_max =
+                    result->max > window->partial_max ? result->max : window->partial_max;
+            }
+            if (++window->partial_periods >= config->periods_per_slot) {
+                window_push(window, config);
+            }
+        }
+    }
+}
+
+/* Statistics over the completed buckets of one window of a channel */
+void window_get_span(uint8_t channel, window_span_t span, window_stats_t *stats) {
+    window_t *window = &window_state[channel][span];
+    memset(stats, 0, sizeof(window_stats_t));
+    stats->count = window->count;
+    if ((window->count > 0) && (window->min.size > 0)) {
+        stats->mean_milli = aggregate_scale(channel, window->sum, window->count);
+        stats->min_milli = aggregate_scale(channel, window_deque_at(&window->min, 0)->value, 1);
+        stats->max_milli = aggregate_scale(channel, window_deque_at(&window->max, 0)->value, 1);
+    }
+}
+
+/* Statistics over the completed buckets of every window of a channel */
+void window_get(uint8_t channel, window_stats_t stats[WINDOW_COUNT]) {
+    for (uint8_t span = 0; span < WINDOW_COUNT; span++) {
+        window_get_span(channel, span, &stats[span]);
+    }
+}
+
+uint32_t window_seconds(window_span_t span) {
+    return window_span_config[span].slots * window_span_config[span].periods_per_slot;
+}
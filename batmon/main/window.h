@@ -0,0 +1,39 @@
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "aggregate.h"
+#include "registry.h"
+
+typedef enum {
+    WINDOW_1S = 0,
+    WINDOW_10S,
+    WINDOW_1M,
+    WINDOW_15M,
+    WINDOW_1H,
+    WINDOW_COUNT,
+} window_span_t;
+
+typedef struct window_stats_t {
+    int32_t mean_milli;
+    int32_t min_milli;
+    int32_t max_milli;
+    uint32_t count; // frames in the window, zero if the window is still empty
+} window_stats_t;
+
+void window_init(void);
+void window_update(const aggregate_result_t results[REGISTRY_CHANNEL_COUNT]);
+void window_get(uint8_t channel, window_stats_t stats[WINDOW_COUNT]);
+void window_get_span(uint8_t channel, window_span_t span, window_stats_t *stats);
+uint32_t window_seconds(window_span_t span);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* WINDOW_H_ */
@@ -0,0 +1,29 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "www.h"
+
+/*
+ * The web UI built into the app image. The build gzips every file under www/, embeds it as
+ * binary data and generates an index sorted by request path with an ETag for each, so a
+ * lookup is a binary search and the data is sent straight from flash without a filesystem.
+ * Pages are embedded uncompressed as well, for clients that do not take gzip.
+ */
+
+const www_asset_t *www_find(const char *path) {
+    size_t low = 0;
+    size_t high = www_asset_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        int order = strcmp(path, www_assets[middle].path);
+        if (order == 0) {
+            return &www_assets[middle];
+        }
+        if (order < 0) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,31 @@
+#ifndef WWW_H
+#define WWW_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct www_asset_t {
+    const char *path;              // as requested, "/index.html"
+    const uint8_t *start;          // gzip data, in place in the mapped app image
+    const uint8_t *end;
+    const char *etag;              // quoted, from a hash of the data
+    const uint8_t *identity_start; // uncompressed copy, pages only, NULL for other assets
+    const uint8_t *identity_end;
+    const char *identity_etag;
+} www_asset_t;
+
+/* Generated by www_embed.py, sorted by path */
+extern const www_asset_t www_assets[];
+extern const size_t www_asset_count;
+
+const www_asset_t *www_find(const char *path);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* WWW_H_ */
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""Gzip the web UI and write the sorted asset index that rest_server.c searches.
+
+Every file under the source directory becomes <path with / as _>.gz in the build directory,
+embedded by target_add_binary_data(), and www_index.c lists them by request path with an
+ETag taken from a hash of the compressed data. Pages (.html) are also copied uncompressed, so a
+client that does not take gzip can still load one; CMakeLists.txt must agree on which files.
+
+usage: www_embed.py <source dir> <build dir>
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+
+def symbol(name):
+    # the same as CMake's MAKE_C_IDENTIFIER, which names the embedded data
+    identifier = re.sub(r"[^A-Za-z0-9_]", "_", name)
+    return "_" + identifier if identifier[0].isdigit() else identifier
+
+
+IDENTITY_EXTENSIONS = (".html",)
+
+
+def main(source_dir, build_dir):
+    os.makedirs(build_dir, exist_ok=True)
+    assets = []
+    for root, _, files in os.walk(source_dir):
+        for file in files:
+            relative = os.path.relpath(os.path.join(root, file), source_dir).replace(os.sep, "/")
+            if relative.endswith(".gz"):
+                continue
+            with open(os.path.join(source_dir, relative), "rb") as f:
+                raw = f.read()
+            data = gzip.compress(raw, compresslevel=9, mtime=0)
+            name = relative.replace("/", "_")
+            with open(os.path.join(build_dir, name + ".gz"), "wb") as f:
+                f.write(data)
+            etag = hashlib.sha1(data).hexdigest()[:16]
+            identity = None
+            if relative.endswith(IDENTITY_EXTENSIONS):
+                with open(os.path.join(build_dir, name), "wb") as f:
+                    f.write(raw)
+                identity = (symbol(name), hashlib.sha1(raw).hexdigest()[:16])
+            assets.append(("/" + relative, symbol(name + ".gz"), etag, identity))
+    assets.sort(key=lambda asset: asset[0].encode())  # the order strcmp() gives
+
+    lines = ["/* Generated by www_embed.py, do not edit */", "", '#include "www.h"', ""]
+    names = [asset[1] for asset in assets] + [asset[3][0] for asset in assets if asset[3]]
+    for name in names:
+        lines.append('extern const uint8_t %s_start[] asm("_binary_%s_start");' % (name, name))
+        lines.append('extern const uint8_t %s_end[] asm("_binary_%s_end");' % (name, name))
+    lines += ["", "const www_asset_t www_assets[] = {"]
+    for path, name, etag, identity in assets:
+        if identity:
+            plain = '%s_start, %s_end, "\\"%s\\""' % (identity[0], identity[0], identity[1])
+        else:
+            plain = "NULL, NULL, NULL"
+        gzipped = '%s_start, %s_end, "\\"%s\\""' % (name, name, etag)
+        lines.append('    {"%s", %s, %s},' % (path, gzipped, plain))
+    lines += ["};", "", "const size_t www_asset_count = %d;" % len(assets), ""]
+    with open(os.path.join(build_dir, "www_index.c"), "w") as f:
+        f.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main(sys.argv[1], sys.argv[2])